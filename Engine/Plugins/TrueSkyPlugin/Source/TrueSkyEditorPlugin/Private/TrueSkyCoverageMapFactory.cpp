@@ -0,0 +1,16 @@
+#include "TrueSkyEditorPluginPrivatePCH.h"
+
+#include "TrueSkyCoverageMapFactory.h"
+#include "TrueSkyCoverageMapAsset.h"
+UTrueSkyCoverageMapFactory::UTrueSkyCoverageMapFactory(const class FPostConstructInitializeProperties& PCIP)
+	: Super(PCIP)
+{
+	bCreateNew = true;
+	bEditAfterNew = true;
+	SupportedClass = UTrueSkyCoverageMapAsset::StaticClass();
+}
+
+UObject* UTrueSkyCoverageMapFactory::FactoryCreateNew(UClass* Class,UObject* InParent,FName Name,EObjectFlags Flags,UObject* Context,FFeedbackContext* Warn)
+{
+	return CastChecked<UTrueSkyCoverageMapAsset>(StaticConstructObject(UTrueSkyCoverageMapAsset::StaticClass(),InParent,Name,Flags));
+}
@@ -0,0 +1,9 @@
+#pragma once
+#include "TrueSkyCoverageMapFactory.generated.h"
+
+UCLASS()
+class UTrueSkyCoverageMapFactory : public UFactory
+{
+	GENERATED_UCLASS_BODY()
+	virtual UObject* FactoryCreateNew(UClass* Class,UObject* InParent,FName Name,EObjectFlags Flags,UObject* Context,FFeedbackContext* Warn) override;
+};
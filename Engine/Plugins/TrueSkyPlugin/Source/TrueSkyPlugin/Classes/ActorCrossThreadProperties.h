@@ -1,19 +1,83 @@
 #pragma once
 #include "TrueSkyPluginPrivatePCH.h"
 
+/** A sequence actor's rendering settings, as copied to the render thread by its UTrueSkyComponent. */
 struct ActorCrossThreadProperties
 {
 	ActorCrossThreadProperties()
-		:Destroyed(false)
-		,Visible(false)
+		:Visible(false)
 		,SimpleCloudShadowing(0.0f)
+		,SimpleCloudShadowSharpness(0.0f)
+		,CloudShadowRange(0.0f)
+		,CloudShadowTarget(NULL)
+		,CloudShadowOrigin(0.0f,0.0f)
+		,CloudDepthOutput(false)
+		,CloudDepthDownscale(4)
+		,PrecipitationTarget(NULL)
+		,PrecipitationMapOrigin(0.0f,0.0f)
+		,PrecipitationMapSize(0.0f)
+		,PrecipitationMapUpdate(0)
+		,InsideCloudMode(false)
+		,InsideCloudThreshold(0.05f)
+		,InsideCloudBlendTime(1.0f)
+		,AboveCloudMode(false)
+		,AboveCloudMargin(50000.0f)
+		,AboveCloudRaymarchDistance(2000000.0f)
+		,AboveCloudHeightfieldRange(20000000.0f)
+		,CloudLayerFastPath(true)
+		,CloudLayerFastPathAltitude(800000.0f)
+		,CloudLayerFastPathDensity(0.05f)
+		,CloudUpdateInterval(0.0f)
+		,Cloud2DUpdateInterval(1.0f)
+		,EmptySpaceSkipping(true)
+		,AdaptiveSkyPaths(true)
+		,CullToVisibility(false)
 		,activeSequence(NULL)
+		,SequenceWindow(INDEX_NONE)
 	{
 	}
-	bool Destroyed;
 	bool Visible;
 	float SimpleCloudShadowing;
 	float SimpleCloudShadowSharpness;
+	float CloudShadowRange;
+	class FTextureRenderTargetResource *CloudShadowTarget;
+	/** World XY of CloudShadowTarget's minimum corner, placed by the actor to match what it gives the light function. */
+	FVector2D CloudShadowOrigin;
+	bool CloudDepthOutput;
+	int CloudDepthDownscale;
+	class FTextureRenderTargetResource *PrecipitationTarget;
+	FVector2D PrecipitationMapOrigin;
+	float PrecipitationMapSize;
+	/** Incremented by the actor each time the precipitation map should be regenerated. */
+	uint32 PrecipitationMapUpdate;
+	bool InsideCloudMode;
+	float InsideCloudThreshold;
+	float InsideCloudBlendTime;
+	bool AboveCloudMode;
+	float AboveCloudMargin;
+	float AboveCloudRaymarchDistance;
+	float AboveCloudHeightfieldRange;
+	bool CloudLayerFastPath;
+	float CloudLayerFastPathAltitude;
+	float CloudLayerFastPathDensity;
+	float CloudUpdateInterval;
+	float Cloud2DUpdateInterval;
+	bool EmptySpaceSkipping;
+	bool AdaptiveSkyPaths;
+	bool CullToVisibility;
+	/** Identifies the sequence on the render thread, which never dereferences it. */
 	class UTrueSkySequenceAsset *activeSequence;
+	/** First keyframe block of the streamed window the sequence text holds, or INDEX_NONE for the whole sequence. */
+	int32 SequenceWindow;
 };
-extern ActorCrossThreadProperties *GetActorCrossThreadProperties();
\ No newline at end of file
+
+/** What the render thread holds of a UTrueSkyComponent. */
+struct FTrueSkyRenderProxy
+{
+	ActorCrossThreadProperties Properties;
+	/** The sequence's text, if the sequence or its window has changed since the last proxy or the text was asked for; otherwise empty. */
+	TArray<uint8> SequenceText;
+};
+
+/** Render thread: replaces the proxy the plugin renders with, taking ownership; NULL stops rendering and frees its resources. */
+extern void SetTrueSkyRenderProxy(FTrueSkyRenderProxy *Proxy);
\ No newline at end of file
@@ -0,0 +1,32 @@
+#pragma once
+
+#include "Materials/MaterialExpressionCustom.h"
+#include "MaterialExpressionTrueSky.generated.h"
+
+UENUM()
+enum ETrueSkyViewValue
+{
+	TSVV_SunDirection UMETA(DisplayName="Sun Direction"),
+	TSVV_SunColor UMETA(DisplayName="Sun Color"),
+	TSVV_MoonDirection UMETA(DisplayName="Moon Direction"),
+	TSVV_TimeOfDay UMETA(DisplayName="Time Of Day"),
+	TSVV_CloudShadow UMETA(DisplayName="Cloud Shadow Strength and Sharpness"),
+};
+
+/**
+ * Reads a trueSKY value from the view uniform buffer. The renderer fills these every frame from the
+ * sky's state, so they cost nothing to bind and match the sky exactly.
+ */
+UCLASS(collapsecategories, hidecategories=(Object, MaterialExpressionCustom))
+class UMaterialExpressionTrueSky : public UMaterialExpressionCustom
+{
+	GENERATED_UCLASS_BODY()
+
+	UPROPERTY(EditAnywhere, Category=TrueSky)
+	TEnumAsByte<ETrueSkyViewValue> Value;
+
+	// Begin UMaterialExpression Interface
+	virtual int32 Compile(class FMaterialCompiler* Compiler, int32 OutputIndex, int32 MultiplexIndex) override;
+	virtual void GetCaption(TArray<FString>& OutCaptions) const override;
+	// End UMaterialExpression Interface
+};
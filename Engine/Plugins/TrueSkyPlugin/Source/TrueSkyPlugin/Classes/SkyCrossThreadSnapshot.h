@@ -0,0 +1,26 @@
+#pragma once
+#include "TrueSkyPluginPrivatePCH.h"
+
+/** Written by the render thread, read by the game thread as a copy taken under a lock. The values lag the GPU by one or two frames. */
+struct SkyCrossThreadSnapshot
+{
+	SkyCrossThreadSnapshot()
+		:SunVisibility(1.0f)
+		,MoonVisibility(1.0f)
+		,VisibilityFrame(0)
+		,VisibilityDistance(0.0f)
+		,SequenceTextNeeded(false)
+	{
+	}
+	/** Transmittance of the sun disk through the clouds, 0 (hidden) to 1 (clear). */
+	float SunVisibility;
+	/** Transmittance of the moon disk through the clouds, 0 (hidden) to 1 (clear). */
+	float MoonVisibility;
+	/** Render frame the visibility values were read back on. */
+	uint32 VisibilityFrame;
+	/** Distance (cm) through the fog and cloud at the camera beyond which nothing can be seen, or 0 for unlimited. */
+	float VisibilityDistance;
+	/** Set when the runtime needs the sequence text again, having freed its copy (cooked builds). */
+	bool SequenceTextNeeded;
+};
+extern SkyCrossThreadSnapshot GetSkyCrossThreadSnapshot();
@@ -0,0 +1,18 @@
+#pragma once
+
+#include "Commandlets/Commandlet.h"
+#include "TrueSkyBakeCommandlet.generated.h"
+
+/**
+ * Bakes sky panoramas (.hdr) and SH lighting from a sequence on the CPU, for build machines without a GPU.
+ * Usage: UE4Editor-Cmd <Project> -run=TrueSkyBake -Sequence=/Game/Sky/MySequence.MySequence -Times=0.25,0.5,0.75 [-Width=1024] [-Out=Dir]
+ */
+UCLASS()
+class UTrueSkyBakeCommandlet : public UCommandlet
+{
+	GENERATED_UCLASS_BODY()
+
+	// Begin UCommandlet interface.
+	virtual int32 Main(const FString& Params) override;
+	// End UCommandlet interface.
+};
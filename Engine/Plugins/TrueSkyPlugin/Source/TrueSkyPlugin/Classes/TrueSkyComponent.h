@@ -1,20 +1,46 @@
 #pragma once
 
 #include "Components/ActorComponent.h"
+#include "ActorCrossThreadProperties.h"
 #include "TrueSkyComponent.generated.h"
+
+/**
+ * The render side of a sequence actor. While registered, the plugin renders with a proxy of its settings and
+ * sequence text; the proxy is only resent when they change, and is released when the component unregisters.
+ */
 UCLASS(ClassGroup=Rendering,hidecategories=(Object, ActorComponent))
 class UTrueSkyComponent : public UActorComponent
 {
 	GENERATED_UCLASS_BODY()
 
 public:
+	/** The settings to render with. Call PropertiesChanged() after writing to them. */
+	ActorCrossThreadProperties &GetProperties()
+	{
+		return Properties;
+	}
+	/** Sends the settings to the render thread at the end of the frame, if they differ from those last sent. */
+	void PropertiesChanged();
+	/** Renders with Text, the active sequence's keyframe window from block Window, or the whole sequence if Window is INDEX_NONE. */
+	void SetSequenceWindow(int32 Window,TArray<uint8> &Text);
+
 	// Begin UActorComponent interface.
-	virtual void OnRegister() override;
-	virtual void InitializeComponent() override;
-	virtual void TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction) override;
-	virtual void OnUnregister() override;
-	// Begin UActorComponent interface.
+	virtual bool ShouldCreateRenderState() const override;
+	virtual void CreateRenderState_Concurrent() override;
+	virtual void SendRenderDynamicData_Concurrent() override;
+	virtual void DestroyRenderState_Concurrent() override;
+	// End UActorComponent interface.
 
 protected:
-};
+	/** Copies the settings, and the sequence's text if it has changed since the last proxy, for the render thread. */
+	FTrueSkyRenderProxy *CreateRenderProxy(bool WithSequenceText);
 
+	ActorCrossThreadProperties Properties;
+	/** As last sent. Compared bytewise: both live in the (zeroed) object, so their padding matches. */
+	ActorCrossThreadProperties SentProperties;
+	/** The sequence the render thread has, kept referenced while it's in use there. */
+	UPROPERTY(transient)
+	class UTrueSkySequenceAsset *SentSequence;
+	/** Text of the streamed keyframe window, kept in case the render thread asks for it again. */
+	TArray<uint8> WindowText;
+};
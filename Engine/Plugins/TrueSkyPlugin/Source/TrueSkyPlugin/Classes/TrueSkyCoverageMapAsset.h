@@ -0,0 +1,83 @@
+#pragma once
+
+#include "TrueSkyCoverageMapAsset.generated.h"
+
+/**
+ * A world-space map of cloud coverage and humidity, authored as a texture and stored as
+ * fixed-size tiles at each mip level. Each tile is bulk data, left on disk until it's wanted,
+ * so that only the tiles around the camera are ever loaded.
+ */
+UCLASS(MinimalAPI)
+class UTrueSkyCoverageMapAsset : public UObject
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+	/** Two bytes per texel: coverage, humidity. */
+	static const int32 BytesPerTexel=2;
+
+#if WITH_EDITORONLY_DATA
+	/** Red is coverage, green humidity. The tiles are rebuilt from it when it changes. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap)
+	class UTexture2D* SourceTexture;
+#endif
+
+	/** World position of the map's minimum corner. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap)
+	FVector2D WorldOrigin;
+
+	/** World-space width (and height) of the map. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "1000.0"))
+	float WorldSize;
+
+	/** Coverage and humidity outside the map. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "0.0", ClampMax = "1.0"))
+	float DefaultCoverage;
+
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "0.0", ClampMax = "1.0"))
+	float DefaultHumidity;
+
+	/** Texels along the side of a tile, rounded up to a power of two. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "16", ClampMax = "256"))
+	int32 TileSize;
+
+	/** Texels along the side of mip 0, a multiple of TileSize. */
+	UPROPERTY(VisibleAnywhere, Category=CoverageMap)
+	int32 Resolution;
+
+	/** Index in Tiles of each mip's first tile. */
+	UPROPERTY()
+	TArray<int32> MipFirstTiles;
+
+	int32			GetNumMips() const
+	{
+		return MipFirstTiles.Num();
+	}
+	/** Tiles along the side of a mip. */
+	int32			GetTilesPerSide(int32 Mip) const;
+	/** World-space width of a texel of a mip. */
+	float			GetTexelSize(int32 Mip) const;
+	/** Copies the tile's texels, row-major, into OutTexels, loading them from the package. False if it's outside the map. Any thread. */
+	bool			GetTile(int32 Mip,int32 TileX,int32 TileY,TArray<uint8> &OutTexels);
+
+	// Begin UObject interface.
+	virtual void	Serialize(FArchive& Ar) override;
+#if WITH_EDITOR
+	virtual void	PostLoad() override;
+	virtual void	PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
+#endif
+	// End UObject interface.
+
+#if WITH_EDITOR
+	/** Rebuilds the tiles and mips from SourceTexture. */
+	void			Build();
+#endif
+
+protected:
+	/** Texels of all the mips, a tile in each, mip by mip and row by row. */
+	TIndirectArray<FByteBulkData> Tiles;
+	/** The package the tiles were loaded from, to read them back from. */
+	FString BulkDataFilename;
+	/** Guards Tiles, which are read from worker threads while the editor may rebuild them. */
+	FCriticalSection TilesCriticalSection;
+};
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "TrueSkyComponent.h"
+#include "TrueSkyWeatherScheduler.h"
+#include "TrueSkyEphemeris.h"
+#include "TaskGraphInterfaces.h"
 #include "TrueSkySequenceActor.generated.h"
 
 
@@ -46,11 +49,81 @@ class ATrueSkySequenceActor : public AActor
 	UFUNCTION(BlueprintCallable, Category=TrueSky)
 	FLinearColor GetSunColor() const;
 
+	UFUNCTION(BlueprintCallable, Category=TrueSky)
+	FRotator GetMoonRotation() const;
+
+	/**
+	 * The sun and moon light rotations as the runtime has them, for the render thread and for tools with no actor.
+	 * A rotation's Vector() is the direction the light travels; the direction towards the sun or moon is its negative.
+	 */
+	static FRotator GetRuntimeSunRotation(class ITrueSkyPlugin &TrueSkyPlugin);
+	static FRotator GetRuntimeMoonRotation(class ITrueSkyPlugin &TrueSkyPlugin);
+
+	/** Transmittance of the sun disk through the clouds (0-1), read back from the GPU with 1-2 frames latency. */
+	UFUNCTION(BlueprintCallable, Category=TrueSky)
+	float GetSunVisibility() const;
+
+	/** Transmittance of the moon disk through the clouds (0-1), read back from the GPU with 1-2 frames latency. */
+	UFUNCTION(BlueprintCallable, Category=TrueSky)
+	float GetMoonVisibility() const;
+
+	/** How far (cm) can be seen through the fog and cloud at the camera, or 0 if there's no limit. */
+	UFUNCTION(BlueprintCallable, Category=TrueSky)
+	float GetVisibilityDistance() const;
+
 	UPROPERTY(EditAnywhere, Category=TrueSky)
 	class UTrueSkySequenceAsset* ActiveSequence;
 
-	//UPROPERTY(EditAnywhere, Category=TrueSky)
-	//UTextureRenderTarget2D* CloudShadowRenderTarget;
+	/** Other sequences, e.g. for weather scripts. They aren't loaded with the level, only when asked for. */
+	UPROPERTY(EditAnywhere, Category=TrueSky)
+	TArray< TAssetPtr<class UTrueSkySequenceAsset> > AlternateSequences;
+
+	/** Keyframe blocks kept in memory around the current time, for sequences cooked with StreamKeyframes. */
+	UPROPERTY(EditAnywhere, Category=TrueSky,meta=(ClampMin = "2", ClampMax = "16"))
+	int32 KeyframeWindowBlocks;
+
+	/** Streams in AlternateSequences[Index] and prepares it, so a later switch to it is immediate. */
+	UFUNCTION(BlueprintCallable, Category=TrueSky)
+	void PrefetchAlternateSequence(int32 Index);
+
+	/** Switches to AlternateSequences[Index] once it has streamed in. The weather scheduler overrides this while enabled. */
+	UFUNCTION(BlueprintCallable, Category=TrueSky)
+	void SwitchToAlternateSequence(int32 Index);
+
+	/** Cycles weather states; while enabled it chooses ActiveSequence. */
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category=Weather)
+	UTrueSkyWeatherScheduler* WeatherScheduler;
+
+	/** Drive the time of day, sun and moon from the real sky at Latitude, Longitude and UTCTime instead of the sequence's keyframes. */
+	UPROPERTY(EditAnywhere, Category=Ephemeris)
+	bool UseEphemeris;
+
+	/** Degrees, north positive. The location of the world origin, for the ephemeris and weather data. */
+	UPROPERTY(EditAnywhere, Category=Ephemeris,meta=(ClampMin = "-90.0", ClampMax = "90.0"))
+	float Latitude;
+
+	/** Degrees, east positive. */
+	UPROPERTY(EditAnywhere, Category=Ephemeris,meta=(ClampMin = "-180.0", ClampMax = "180.0"))
+	float Longitude;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Ephemeris,meta=(EditCondition="UseEphemeris"))
+	FDateTime UTCTime;
+
+	/** Simulated seconds per real second that UTCTime advances by; 0 freezes it. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Ephemeris,meta=(EditCondition="UseEphemeris"))
+	float EphemerisTimeScale;
+
+	/** Sun and moon at UTCTime, as last computed. */
+	UFUNCTION(BlueprintCallable, Category=Ephemeris)
+	void GetEphemeris(float &SunAzimuth,float &SunElevation,float &MoonAzimuth,float &MoonElevation,float &MoonPhase) const;
+
+	/** Optional target the cloud shadow is rendered into, CloudShadowRange either side of the camera, for a light function on the sun to sample. */
+	UPROPERTY(EditAnywhere, Category=TrueSky)
+	UTextureRenderTarget2D* CloudShadowRenderTarget;
+
+	/** Optional collection that receives "CloudShadowTransform" (world XY to CloudShadowRenderTarget's UV: x,y offset, z,w scale) for the light function. */
+	UPROPERTY(EditAnywhere, Category=TrueSky)
+	class UMaterialParameterCollection* CloudShadowParameters;
 
 	UPROPERTY(EditAnywhere, Category=TrueSky,meta=(ClampMin = "0.0", ClampMax = "1.0"))
 	float SimpleCloudShadowing;
@@ -58,8 +131,158 @@ class ATrueSkySequenceActor : public AActor
 	UPROPERTY(EditAnywhere, Category=TrueSky,meta=(ClampMin = "0.0", ClampMax = "1.0"))
 	float SimpleCloudShadowSharpness;
 
+	/** Distance from the camera that the directional light's native cloud shadow reaches. */
+	UPROPERTY(EditAnywhere, Category=TrueSky,meta=(ClampMin = "10000.0"))
+	float CloudShadowRange;
+
 	UPROPERTY(EditAnywhere, Category=TrueSky)
 	bool Visible;
+
+	/** Output the clouds' average transmittance depth, so depth of field, fog and soft particles can use it. */
+	UPROPERTY(EditAnywhere, Category=TrueSky)
+	bool CloudDepthOutput;
+
+	/** Resolution divisor of the cloud depth output, relative to the view. */
+	UPROPERTY(EditAnywhere, Category=TrueSky,meta=(ClampMin = "1", ClampMax = "8", EditCondition="CloudDepthOutput"))
+	int32 CloudDepthDownscale;
+
+	/** If set, trueSKY renders a top-down map of where precipitation falls around the camera into this target. */
+	UPROPERTY(EditAnywhere, Category=Precipitation)
+	UTextureRenderTarget2D* PrecipitationRenderTarget;
+
+	/** World-space width covered by the precipitation map. */
+	UPROPERTY(EditAnywhere, Category=Precipitation,meta=(ClampMin = "1000.0"))
+	float PrecipitationMapSize;
+
+	/** Seconds between precipitation map updates. */
+	UPROPERTY(EditAnywhere, Category=Precipitation,meta=(ClampMin = "0.0"))
+	float PrecipitationMapUpdateInterval;
+
+	/** Optional collection that receives "PrecipitationMapOrigin" (x,y = world origin, z = size) for materials and particles. */
+	UPROPERTY(EditAnywhere, Category=Precipitation)
+	class UMaterialParameterCollection* PrecipitationParameters;
+
+	/**
+	 * Gridded forecast (.tsgrid, relative to the project directory) to drive the cloud coverage from.
+	 * It is placed at Latitude and Longitude, and interpolated to UTCTime.
+	 */
+	UPROPERTY(EditAnywhere, Category=WeatherData)
+	FString WeatherDataFile;
+
+	/** World-space width of the coverage around the camera that is taken from the weather data. */
+	UPROPERTY(EditAnywhere, Category=WeatherData,meta=(ClampMin = "100000.0"))
+	float CoverageInputSize;
+
+	UPROPERTY(EditAnywhere, Category=WeatherData,meta=(ClampMin = "16", ClampMax = "1024"))
+	int32 CoverageInputResolution;
+
+	/** Seconds between resampling the weather data. */
+	UPROPERTY(EditAnywhere, Category=WeatherData,meta=(ClampMin = "0.0"))
+	float WeatherDataUpdateInterval;
+
+	/** Render with a cheaper fog approximation and shorter, coarser marching when the camera is inside cloud. */
+	UPROPERTY(EditAnywhere, Category=Performance)
+	bool InsideCloudMode;
+
+	/** Cloud density at the camera above which it counts as inside. */
+	UPROPERTY(EditAnywhere, Category=Performance,meta=(ClampMin = "0.0", ClampMax = "1.0", EditCondition="InsideCloudMode"))
+	float InsideCloudThreshold;
+
+	/** Seconds to blend into and out of inside-cloud rendering. */
+	UPROPERTY(EditAnywhere, Category=Performance,meta=(ClampMin = "0.0", EditCondition="InsideCloudMode"))
+	float InsideCloudBlendTime;
+
+	/**
+	 * Detect clear skies, night and full overcast from the sky's current values, and skip the clouds, lower
+	 * the sample counts and resolution, or skip the atmosphere above the clouds accordingly. See "stat TrueSky".
+	 */
+	UPROPERTY(EditAnywhere, Category=Performance)
+	bool AdaptiveSkyPaths;
+
+	/** Cull geometry beyond GetVisibilityDistance(), e.g. in dense cloud or fog. Needs the renderer modifications. */
+	UPROPERTY(EditAnywhere, Category=Performance)
+	bool CullToVisibility;
+
+	/** Skip empty space in the cloud raymarch using a coarse occupancy volume, rebuilt when the cloud density changes. */
+	UPROPERTY(EditAnywhere, Category=Performance)
+	bool EmptySpaceSkipping;
+
+	/**
+	 * When the camera is above the cloud layer, raymarch only the nearby clouds and draw the distant
+	 * cloud tops as a lit heightfield derived from the cloud volume.
+	 */
+	UPROPERTY(EditAnywhere, Category=Performance)
+	bool AboveCloudMode;
+
+	/** Height above the top of the cloud layer at which the camera counts as above it. */
+	UPROPERTY(EditAnywhere, Category=Performance,meta=(ClampMin = "0.0", EditCondition="AboveCloudMode"))
+	float AboveCloudMargin;
+
+	/** Distance within which clouds are still raymarched in above-cloud mode. */
+	UPROPERTY(EditAnywhere, Category=Performance,meta=(ClampMin = "10000.0", EditCondition="AboveCloudMode"))
+	float AboveCloudRaymarchDistance;
+
+	/** World-space width of the cloud-top heightfield around the camera. */
+	UPROPERTY(EditAnywhere, Category=Performance,meta=(ClampMin = "100000.0", EditCondition="AboveCloudMode"))
+	float AboveCloudHeightfieldRange;
+
+	/**
+	 * Render the volumetric cloud layer as a lit 2D layer with parallax when it is high or thin enough that
+	 * the volume adds little - e.g. cirrus.
+	 */
+	UPROPERTY(EditAnywhere, Category=CloudLayers)
+	bool CloudLayerFastPath;
+
+	/** Cloud base altitude above which the layer is drawn in 2D. */
+	UPROPERTY(EditAnywhere, Category=CloudLayers,meta=(ClampMin = "0.0", EditCondition="CloudLayerFastPath"))
+	float CloudLayerFastPathAltitude;
+
+	/** Cloud density (times coverage) below which the layer is drawn in 2D. */
+	UPROPERTY(EditAnywhere, Category=CloudLayers,meta=(ClampMin = "0.0", ClampMax = "1.0", EditCondition="CloudLayerFastPath"))
+	float CloudLayerFastPathDensity;
+
+	/** Seconds between updates of the volumetric cloud layer's lighting and density, or zero for every frame. */
+	UPROPERTY(EditAnywhere, Category=CloudLayers,meta=(ClampMin = "0.0"))
+	float CloudUpdateInterval;
+
+	/** Seconds between updates of the 2D cloud layer, or zero for every frame. */
+	UPROPERTY(EditAnywhere, Category=CloudLayers,meta=(ClampMin = "0.0"))
+	float Cloud2DUpdateInterval;
+
+	/** The sun's directional light, for ScaleShadowBudget. */
+	UPROPERTY(EditAnywhere, Category=ShadowBudget)
+	class ADirectionalLight* SunLight;
+
+	/**
+	 * Reduce SunLight's cascades, shadow distance and resolution when the sun is hidden by cloud, and at night
+	 * point it at the moon with a lighter budget still. The light's own settings are the full budget.
+	 */
+	UPROPERTY(EditAnywhere, Category=ShadowBudget)
+	bool ScaleShadowBudget;
+
+	/** Fraction of the full shadow budget used when the sun is hidden by cloud. */
+	UPROPERTY(EditAnywhere, Category=ShadowBudget,meta=(ClampMin = "0.0", ClampMax = "1.0", EditCondition="ScaleShadowBudget"))
+	float OvercastShadowBudget;
+
+	/** Fraction of the full shadow budget used for the moon. */
+	UPROPERTY(EditAnywhere, Category=ShadowBudget,meta=(ClampMin = "0.0", ClampMax = "1.0", EditCondition="ScaleShadowBudget"))
+	float NightShadowBudget;
+
+	/** Authored coverage for the world, streamed in around the camera. Takes the place of WeatherDataFile. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap)
+	class UTrueSkyCoverageMapAsset* CoverageMap;
+
+	/** Distance around the camera the resident tiles must cover; coarser mips are used for longer ranges. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "10000.0"))
+	float CoverageMapRange;
+
+	/** Budget of tiles kept in the coverage input. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "4", ClampMax = "256"))
+	int32 CoverageMapResidentTiles;
+
+	/** Most tiles uploaded in one frame, to spread the cost of the camera moving. */
+	UPROPERTY(EditAnywhere, Category=CoverageMap,meta=(ClampMin = "1", ClampMax = "16"))
+	int32 CoverageMapUploadsPerFrame;
 	void PostInitProperties() override;
 	void PostLoad() override;
 	void PostInitializeComponents() override;
@@ -68,6 +291,45 @@ class ATrueSkySequenceActor : public AActor
 	void PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent) override;
 #endif
 protected:
+	UPROPERTY()
 	UTrueSkyComponent *trueSkyComponent;
 	void TransferProperties();
+	void UpdatePrecipitationMap(float DeltaTime);
+	void UpdateCloudShadowMap();
+	void UpdateEphemeris(float DeltaTime);
+	void UpdateWeatherData(float DeltaTime);
+	void ReleaseWeatherData();
+	void UpdateCoverageMap();
+	void UpdateShadowBudget(float DeltaTime);
+	void UpdatePendingSequence();
+	void UpdateKeyframeWindow();
+	class FTrueSkyKeyframeStreamer *KeyframeStreamer;
+	/** The alternate being switched to, and the one streamed in and in use. */
+	TAssetPtr<class UTrueSkySequenceAsset> PendingSequence;
+	TAssetPtr<class UTrueSkySequenceAsset> StreamedSequence;
+	void ApplyShadowBudget(class UDirectionalLightComponent *Light,float Budget);
+	enum EShadowBudgetTier
+	{
+		SHADOW_BUDGET_FULL,
+		SHADOW_BUDGET_OVERCAST,
+		SHADOW_BUDGET_NIGHT
+	};
+	EShadowBudgetTier ShadowBudgetTier;
+	float ShadowBudgetHoldTime;
+	/** The light's own settings, captured when it's first scaled. */
+	TWeakObjectPtr<class UDirectionalLightComponent> ShadowBudgetLight;
+	int32 FullShadowCascades;
+	float FullShadowDistance;
+	float FullShadowResolutionScale;
+	class FTrueSkyCoverageMapStreamer *CoverageMapStreamer;
+	class FTrueSkyWeatherGrid *WeatherGrid;
+	FString WeatherGridFile;
+	/** The sample in flight on a worker thread, and its result. */
+	FGraphEventRef WeatherGridTask;
+	TArray<FFloat16Color> *WeatherGridTexels;
+	FVector2D WeatherGridOrigin;
+	float WeatherDataTimer;
+	FTrueSkyEphemerisResult Ephemeris;
+	float PrecipitationMapTimer;
+	FVector2D PrecipitationMapOrigin;
 };
@@ -2,6 +2,25 @@
 
 #include "TrueSkySequenceAsset.generated.h"
 
+/** Error allowed in a parameter, or a layer's parameters, when keyframes are simplified for cooking. */
+USTRUCT()
+struct FTrueSkyKeyframeTolerance
+{
+	GENERATED_USTRUCT_BODY()
+
+	/** A parameter ("cloudiness"), a layer ("clouds"), or a layer's parameter ("clouds.cloudiness"). */
+	UPROPERTY(EditAnywhere, Category=Cooking)
+	FString Name;
+
+	UPROPERTY(EditAnywhere, Category=Cooking,meta=(ClampMin = "0.0"))
+	float Tolerance;
+
+	FTrueSkyKeyframeTolerance()
+		:Tolerance(0.001f)
+	{
+	}
+};
+
 UCLASS(MinimalAPI)
 class UTrueSkySequenceAsset : public UObject
 {
@@ -9,6 +28,60 @@ class UTrueSkySequenceAsset : public UObject
 
 public:
 
+	/** The sequence, as edited. Empty in cooked builds, where the text is in bulk data and only loaded on request. */
 	UPROPERTY()
 	TArray<uint8> SequenceText;
+
+	/**
+	 * Cook without the keyframes that the curves through their neighbours pass within tolerance of, so there are
+	 * fewer to load and search. The editor keeps them all.
+	 */
+	UPROPERTY(EditAnywhere, Category=Cooking)
+	bool SimplifyKeyframes;
+
+	/** Error allowed in parameters not in KeyframeTolerances. */
+	UPROPERTY(EditAnywhere, Category=Cooking,meta=(ClampMin = "0.0", EditCondition="SimplifyKeyframes"))
+	float KeyframeTolerance;
+
+	/** Error allowed in particular parameters or layers, the most specific name applying. */
+	UPROPERTY(EditAnywhere, Category=Cooking,meta=(EditCondition="SimplifyKeyframes"))
+	TArray<FTrueSkyKeyframeTolerance> KeyframeTolerances;
+
+	/**
+	 * Cook the keyframes into blocks of KeyframeBlockDays, so that a long timeline needs only a window of them
+	 * around the current time in memory. The rest of the timeline falls back to a coarse subset of its keyframes.
+	 */
+	UPROPERTY(EditAnywhere, Category=Streaming)
+	bool StreamKeyframes;
+
+	/** Length of a cooked block of keyframes, in days. */
+	UPROPERTY(EditAnywhere, Category=Streaming,meta=(ClampMin = "0.01", EditCondition="StreamKeyframes"))
+	float KeyframeBlockDays;
+
+	/** Copies the sequence text into OutText, loading it from the package in cooked builds. Game thread. */
+	bool GetSequenceText(TArray<uint8> &OutText);
+
+	/** Cooked blocks of keyframes; none unless StreamKeyframes was set when cooking. */
+	int32 GetNumKeyframeBlocks() const
+	{
+		return KeyframeBlocks.Num();
+	}
+	/** Copies a block of keyframes into OutBlock, loading it from the package. Game thread. */
+	bool GetKeyframeBlock(int32 Index,TArray<uint8> &OutBlock);
+
+	// Begin UObject interface.
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void BeginDestroy() override;
+	// End UObject interface.
+
+protected:
+	/** Removes the keyframes within tolerance of the curves, logging how many went and the gain. */
+	void SimplifyForCooking(TArray<uint8> &Text) const;
+
+	/** Cooked builds: the text, left on disk except while it's being copied. With streamed keyframes, only the coarse ones. */
+	FByteBulkData CookedSequenceText;
+	/** Cooked builds: each block's keyframes, also left on disk. */
+	TIndirectArray<FByteBulkData> KeyframeBlocks;
+	/** The package the bulk data was loaded from, to read it back from once it's been discarded. */
+	FString BulkDataFilename;
 };
@@ -0,0 +1,141 @@
+#pragma once
+
+#include "Components/ActorComponent.h"
+#include "TrueSkyWeatherScheduler.generated.h"
+
+/** A render value that a weather state holds, e.g. "CloudCoverage". */
+USTRUCT()
+struct FTrueSkyWeatherParameter
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, Category=Weather)
+	FString Name;
+
+	UPROPERTY(EditAnywhere, Category=Weather)
+	float Value;
+
+	FTrueSkyWeatherParameter()
+		:Value(0.0f)
+	{
+	}
+};
+
+USTRUCT()
+struct FTrueSkyWeatherState
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, Category=Weather)
+	FName Name;
+
+	/** Sequence to switch to in this state; if none, the current sequence is kept. Streamed in when the state is next.
+	  * The switch is a cut at the start of the state: only the Parameters blend, from their values under the outgoing sequence. */
+	UPROPERTY(EditAnywhere, Category=Weather)
+	TAssetPtr<class UTrueSkySequenceAsset> Sequence;
+
+	/** Values blended to on entering this state. */
+	UPROPERTY(EditAnywhere, Category=Weather)
+	TArray<FTrueSkyWeatherParameter> Parameters;
+
+	/** Seconds the state lasts, chosen at random between the two. */
+	UPROPERTY(EditAnywhere, Category=Weather,meta=(ClampMin = "0.0"))
+	float MinDuration;
+
+	UPROPERTY(EditAnywhere, Category=Weather,meta=(ClampMin = "0.0"))
+	float MaxDuration;
+
+	/** Seconds to blend the parameters in over. */
+	UPROPERTY(EditAnywhere, Category=Weather,meta=(ClampMin = "0.0"))
+	float BlendTime;
+
+	FTrueSkyWeatherState()
+		:MinDuration(300.0f)
+		,MaxDuration(600.0f)
+		,BlendTime(30.0f)
+	{
+	}
+};
+
+/** A weighted edge between two states; the weights of the edges leaving a state are relative to each other. */
+USTRUCT()
+struct FTrueSkyWeatherTransition
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, Category=Weather)
+	FName From;
+
+	UPROPERTY(EditAnywhere, Category=Weather)
+	FName To;
+
+	UPROPERTY(EditAnywhere, Category=Weather,meta=(ClampMin = "0.0"))
+	float Weight;
+
+	FTrueSkyWeatherTransition()
+		:Weight(1.0f)
+	{
+	}
+};
+
+/**
+ * Cycles the sky through weather states. The next state is chosen as soon as the current one
+ * begins, so its sequence is prepared on the plugin's worker thread long before it's needed,
+ * and the parameter blends run natively each tick.
+ */
+UCLASS(ClassGroup=Rendering,hidecategories=(Object, ActorComponent))
+class UTrueSkyWeatherScheduler : public UActorComponent
+{
+	GENERATED_UCLASS_BODY()
+
+public:
+	UPROPERTY(EditAnywhere, Category=Weather)
+	bool Enabled;
+
+	UPROPERTY(EditAnywhere, Category=Weather)
+	TArray<FTrueSkyWeatherState> States;
+
+	/** If a state has no outgoing transitions, any other state may follow it with equal weight. */
+	UPROPERTY(EditAnywhere, Category=Weather)
+	TArray<FTrueSkyWeatherTransition> Transitions;
+
+	/** State to start in; the first state if None. */
+	UPROPERTY(EditAnywhere, Category=Weather)
+	FName InitialState;
+
+	/** Fixes the random sequence of states; 0 picks a new seed each run. */
+	UPROPERTY(EditAnywhere, Category=Weather)
+	int32 RandomSeed;
+
+	/** Name of the current state, or the one being blended to. */
+	UFUNCTION(BlueprintCallable, Category=Weather)
+	FName GetCurrentState() const;
+
+	/** Name of the state that will follow the current one. */
+	UFUNCTION(BlueprintCallable, Category=Weather)
+	FName GetNextState() const;
+
+	/** Starts blending to the named state now, instead of when the current one ends. */
+	UFUNCTION(BlueprintCallable, Category=Weather)
+	void ForceState(FName Name);
+
+	/**
+	 * Called by the sequence actor each tick. Returns the sequence the actor should use, or NULL to keep its own -
+	 * including while the current state's sequence is still streaming in.
+	 */
+	class UTrueSkySequenceAsset* Update(float DeltaTime);
+
+protected:
+	int32			FindState(FName Name) const;
+	int32			ChooseNextState(int32 From);
+	void			EnterState(int32 Index);
+
+	FRandomStream	RandomStream;
+	bool			Started;
+	int32			CurrentState;
+	int32			NextState;
+	float			StateTime;
+	float			StateDuration;
+	/** The values at the start of the current blend, one per parameter of the current state. */
+	TArray<float>	BlendFrom;
+};
@@ -0,0 +1,47 @@
+#include "TrueSkyPluginPrivatePCH.h"
+#include "MaterialExpressionTrueSky.h"
+
+UMaterialExpressionTrueSky::UMaterialExpressionTrueSky(const class FPostConstructInitializeProperties& PCIP)
+	: Super(PCIP)
+	, Value(TSVV_SunDirection)
+{
+	Inputs.Empty();
+	MenuCategories.Empty();
+	MenuCategories.Add(NSLOCTEXT("TrueSky", "TrueSky", "TrueSky"));
+}
+
+int32 UMaterialExpressionTrueSky::Compile(class FMaterialCompiler* Compiler, int32 OutputIndex, int32 MultiplexIndex)
+{
+	// The members are declared in FViewUniformShaderParameters; see the plugin's README.
+	switch(Value)
+	{
+	default:
+	case TSVV_SunDirection:
+		Code		=TEXT("return View.SkySunDirection;");
+		OutputType	=CMOT_Float3;
+		break;
+	case TSVV_SunColor:
+		Code		=TEXT("return View.SkySunColor.rgb;");
+		OutputType	=CMOT_Float3;
+		break;
+	case TSVV_MoonDirection:
+		Code		=TEXT("return View.SkyMoonDirection;");
+		OutputType	=CMOT_Float3;
+		break;
+	case TSVV_TimeOfDay:
+		Code		=TEXT("return View.SkyParameters.x;");
+		OutputType	=CMOT_Float1;
+		break;
+	case TSVV_CloudShadow:
+		Code		=TEXT("return View.SkyParameters.yz;");
+		OutputType	=CMOT_Float2;
+		break;
+	}
+	return Super::Compile(Compiler,OutputIndex,MultiplexIndex);
+}
+
+void UMaterialExpressionTrueSky::GetCaption(TArray<FString>& OutCaptions) const
+{
+	static const TCHAR *Captions[]={TEXT("Sun Direction"),TEXT("Sun Color"),TEXT("Moon Direction"),TEXT("Time Of Day"),TEXT("Cloud Shadow")};
+	OutCaptions.Add(FString(TEXT("TrueSky "))+Captions[FMath::Clamp((int32)Value,0,(int32)ARRAY_COUNT(Captions)-1)]);
+}
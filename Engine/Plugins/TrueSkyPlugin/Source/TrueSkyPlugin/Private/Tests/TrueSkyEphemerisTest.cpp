@@ -0,0 +1,29 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "AutomationTest.h"
+#include "TrueSkyEphemeris.h"
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrueSkyEphemerisTest,"TrueSky.Ephemeris",EAutomationTestFlags::ATF_Editor)
+
+bool FTrueSkyEphemerisTest::RunTest(const FString &Parameters)
+{
+	// Greenwich at noon UTC on the 2014 June solstice: just short of transit, with the equation of time at -1.6 minutes.
+	FTrueSkyEphemerisResult Noon=FTrueSkyEphemeris::Compute(51.4769,0.0,FDateTime(2014,6,21,12,0,0));
+	TestTrue(FString::Printf(TEXT("Solstice sun elevation %f, expected 61.96"),Noon.SunElevation),FMath::Abs(Noon.SunElevation-61.96f)<0.1f);
+	TestTrue(FString::Printf(TEXT("Solstice sun azimuth %f, expected 179.13"),Noon.SunAzimuth),FMath::Abs(Noon.SunAzimuth-179.13f)<0.5f);
+	// Half a day later the sun is below the northern horizon, at -(90-51.48-23.44) degrees.
+	FTrueSkyEphemerisResult Midnight=FTrueSkyEphemeris::Compute(51.4769,0.0,FDateTime(2014,6,22,0,0,0));
+	TestTrue(FString::Printf(TEXT("Solstice midnight sun elevation %f, expected -15.1"),Midnight.SunElevation),FMath::Abs(Midnight.SunElevation+15.1f)<0.2f);
+	// The full moon of 12 July 2014, 11:25 UTC.
+	FTrueSkyEphemerisResult Full=FTrueSkyEphemeris::Compute(51.4769,0.0,FDateTime(2014,7,12,11,25,0));
+	TestTrue(FString::Printf(TEXT("Full moon illumination %f"),Full.MoonIllumination),Full.MoonIllumination>0.99f);
+	TestTrue(FString::Printf(TEXT("Full moon phase %f"),Full.MoonPhase),FMath::Abs(Full.MoonPhase-0.5f)<0.02f);
+	// The batch form agrees with the single one.
+	double JulianDate=FTrueSkyEphemeris::GetJulianDate(FDateTime(2014,6,21,12,0,0));
+	float SunAzimuth=0.0f,SunElevation=0.0f;
+	FTrueSkyEphemeris::Compute(1,&JulianDate,51.4769,0.0,&SunAzimuth,&SunElevation,NULL,NULL,NULL,NULL);
+	TestEqual(TEXT("Batch sun azimuth"),SunAzimuth,Noon.SunAzimuth);
+	TestEqual(TEXT("Batch sun elevation"),SunElevation,Noon.SunElevation);
+	return true;
+}
@@ -0,0 +1,180 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "AutomationTest.h"
+#include "TrueSkySequenceKeyframes.h"
+#include "Json.h"
+
+static void ToText(const FString &String,TArray<uint8> &OutText)
+{
+	FTCHARToANSI Converted(*String);
+	OutText.Empty(Converted.Length()+1);
+	OutText.Append((const uint8*)Converted.Get(),Converted.Length());
+	OutText.Add(0);
+}
+
+/** Two layers of Count keyframes over Days, each with an untimed keyframe, and a member that isn't a layer. */
+static FString MakeSequence(int32 Count,float Days)
+{
+	FString Sequence=TEXT("{\"name\":\"test\"");
+	const TCHAR *Layers[]={TEXT("sky"),TEXT("clouds")};
+	for(int32 l=0;l<ARRAY_COUNT(Layers);l++)
+	{
+		Sequence+=FString::Printf(TEXT(",\"%s\":{\"keyframes\":[{\"uid\":%d}"),Layers[l],l);
+		for(int32 i=0;i<Count;i++)
+		{
+			// Mid-interval times, clear of the block boundaries.
+			float Day=(i+0.5f)*Days/Count;
+			Sequence+=FString::Printf(TEXT(",{\"daytime\":%f,\"value\":%d}"),Day,i*(l+1));
+		}
+		Sequence+=TEXT("]}");
+	}
+	Sequence+=TEXT("}");
+	return Sequence;
+}
+
+/** Counts the keyframes in Text from StartDay up to EndDay, over all layers. */
+static int32 CountKeyframes(const TArray<uint8> &Text,float StartDay,float EndDay)
+{
+	TArray<ANSICHAR> Terminated;
+	Terminated.Append((const ANSICHAR*)Text.GetData(),Text.Num());
+	Terminated.Add(0);
+	TSharedPtr<FJsonObject> Sequence;
+	TSharedRef< TJsonReader<TCHAR> > Reader=TJsonReaderFactory<TCHAR>::Create(ANSI_TO_TCHAR(Terminated.GetData()));
+	if(!FJsonSerializer::Deserialize(Reader,Sequence)||!Sequence.IsValid())
+		return INDEX_NONE;
+	int32 Count=0;
+	for(auto It=Sequence->Values.CreateConstIterator();It;++It)
+	{
+		if(It.Value()->Type!=EJson::Object||!It.Value()->AsObject()->HasTypedField<EJson::Array>(TEXT("keyframes")))
+			continue;
+		const TArray< TSharedPtr<FJsonValue> > &Keyframes=It.Value()->AsObject()->GetArrayField(TEXT("keyframes"));
+		for(int32 i=0;i<Keyframes.Num();i++)
+		{
+			TSharedPtr<FJsonObject> Keyframe=Keyframes[i]->AsObject();
+			if(!Keyframe->HasTypedField<EJson::Number>(TEXT("daytime")))
+				continue;
+			double Day=Keyframe->GetNumberField(TEXT("daytime"));
+			if(Day>=StartDay&&Day<EndDay)
+				Count++;
+		}
+	}
+	return Count;
+}
+
+/** Layer's timed keyframes as (daytime, Name) pairs, in time order. */
+static bool GetCurve(const TArray<uint8> &Text,const FString &Layer,const FString &Name,TArray<FVector2D> &OutCurve)
+{
+	TArray<ANSICHAR> Terminated;
+	Terminated.Append((const ANSICHAR*)Text.GetData(),Text.Num());
+	Terminated.Add(0);
+	TSharedPtr<FJsonObject> Sequence;
+	TSharedRef< TJsonReader<TCHAR> > Reader=TJsonReaderFactory<TCHAR>::Create(ANSI_TO_TCHAR(Terminated.GetData()));
+	if(!FJsonSerializer::Deserialize(Reader,Sequence)||!Sequence.IsValid()||!Sequence->HasTypedField<EJson::Object>(Layer))
+		return false;
+	const TArray< TSharedPtr<FJsonValue> > &Keyframes=Sequence->GetObjectField(Layer)->GetArrayField(TEXT("keyframes"));
+	OutCurve.Empty();
+	for(int32 i=0;i<Keyframes.Num();i++)
+	{
+		TSharedPtr<FJsonObject> Keyframe=Keyframes[i]->AsObject();
+		if(Keyframe->HasTypedField<EJson::Number>(TEXT("daytime")))
+			OutCurve.Add(FVector2D(Keyframe->GetNumberField(TEXT("daytime")),Keyframe->GetNumberField(Name)));
+	}
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrueSkyKeyframeSplitMergeTest,"TrueSky.Keyframes.SplitMerge",EAutomationTestFlags::ATF_Editor)
+
+bool FTrueSkyKeyframeSplitMergeTest::RunTest(const FString &Parameters)
+{
+	const int32 Count		=64;
+	const float Days		=8.0f;
+	const float BlockDays	=1.0f;
+	TArray<uint8> Text;
+	ToText(MakeSequence(Count,Days),Text);
+	// Merging no blocks over an empty range just rewrites the text, for comparing against.
+	TArray<uint8> Expected;
+	TArray< TArray<uint8> > NoBlocks;
+	if(!FTrueSkySequenceKeyframes::Merge(Text,NoBlocks,0.0f,0.0f,Expected))
+	{
+		AddError(TEXT("Can't parse the test sequence"));
+		return false;
+	}
+	TArray<uint8> Coarse;
+	TArray< TArray<uint8> > Blocks;
+	if(!FTrueSkySequenceKeyframes::Split(Text,BlockDays,Coarse,Blocks))
+	{
+		AddError(TEXT("Split failed"));
+		return false;
+	}
+	TestEqual(TEXT("Block count"),Blocks.Num(),(int32)(Days/BlockDays));
+	TestTrue(TEXT("Coarse sequence has fewer keyframes"),CountKeyframes(Coarse,0.0f,Days)<CountKeyframes(Text,0.0f,Days));
+	// All the blocks over the whole sequence give back the original.
+	TArray<uint8> Merged;
+	TestTrue(TEXT("Merge of all blocks"),FTrueSkySequenceKeyframes::Merge(Coarse,Blocks,0.0f,Blocks.Num()*BlockDays,Merged));
+	TestTrue(TEXT("Merge of all blocks matches the original"),Merged==Expected);
+	// A window has the original's keyframes inside it, and only the coarse ones outside.
+	const int32 First=2,WindowBlocks=3;
+	TArray< TArray<uint8> > Window;
+	for(int32 b=First;b<First+WindowBlocks;b++)
+		Window.Add(Blocks[b]);
+	float StartDay=First*BlockDays,EndDay=(First+WindowBlocks)*BlockDays;
+	TestTrue(TEXT("Merge of a window"),FTrueSkySequenceKeyframes::Merge(Coarse,Window,StartDay,EndDay,Merged));
+	TestEqual(TEXT("Keyframes inside the window"),CountKeyframes(Merged,StartDay,EndDay),CountKeyframes(Text,StartDay,EndDay));
+	TestEqual(TEXT("Keyframes before the window"),CountKeyframes(Merged,0.0f,StartDay),CountKeyframes(Coarse,0.0f,StartDay));
+	TestEqual(TEXT("Keyframes after the window"),CountKeyframes(Merged,EndDay,Days),CountKeyframes(Coarse,EndDay,Days));
+	return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrueSkyKeyframeSimplifyTest,"TrueSky.Keyframes.Simplify",EAutomationTestFlags::ATF_Editor)
+
+bool FTrueSkyKeyframeSimplifyTest::RunTest(const FString &Parameters)
+{
+	const int32 Count		=200;
+	const float Tolerance	=0.01f;
+	// A smooth curve, a straight run, and a step, so that some keyframes go and some have to stay.
+	FString Sequence=TEXT("{\"sky\":{\"keyframes\":[");
+	for(int32 i=0;i<Count;i++)
+	{
+		float Day	=(float)i/Count;
+		float Value	=Day<0.5f?FMath::Sin(Day*4.0f*PI):Day<0.8f?Day:Day+1.0f;
+		Sequence+=FString::Printf(TEXT("%s{\"daytime\":%f,\"value\":%f}"),i?TEXT(","):TEXT(""),Day,Value);
+	}
+	Sequence+=TEXT("]}}");
+	TArray<uint8> Text,Simplified;
+	ToText(Sequence,Text);
+	TMap<FString,float> Tolerances;
+	FTrueSkySequenceKeyframes::FSimplifyStats Stats;
+	if(!FTrueSkySequenceKeyframes::Simplify(Text,Tolerance,Tolerances,Simplified,Stats))
+	{
+		AddError(TEXT("Simplify failed"));
+		return false;
+	}
+	TArray<FVector2D> Before,After;
+	if(!GetCurve(Text,TEXT("sky"),TEXT("value"),Before)||!GetCurve(Simplified,TEXT("sky"),TEXT("value"),After))
+	{
+		AddError(TEXT("Can't read the keyframes back"));
+		return false;
+	}
+	TestEqual(TEXT("Keyframes before"),Stats.KeyframesBefore,Count);
+	TestEqual(TEXT("Keyframes after"),Stats.KeyframesAfter,After.Num());
+	TestTrue(TEXT("Keyframes removed"),After.Num()<Count);
+	TestTrue(TEXT("Ends kept"),After.Num()>=2&&After[0]==Before[0]&&After.Last()==Before.Last());
+	// Every keyframe removed is within tolerance of the simplified curve at its time.
+	int32 Span=0;
+	for(int32 i=0;i<Before.Num()&&After.Num()>=2;i++)
+	{
+		while(Span+2<After.Num()&&After[Span+1].X<=Before[i].X)
+			Span++;
+		const FVector2D &A=After[Span],&B=After[Span+1];
+		float Alpha		=B.X>A.X?(Before[i].X-A.X)/(B.X-A.X):0.0f;
+		float Error		=FMath::Abs(Before[i].Y-FMath::Lerp(A.Y,B.Y,Alpha));
+		// The text rounds values to six places.
+		if(Error>Tolerance+1e-5f)
+		{
+			AddError(FString::Printf(TEXT("Keyframe at %f is %f from the simplified curve"),Before[i].X,Error));
+			break;
+		}
+	}
+	return true;
+}
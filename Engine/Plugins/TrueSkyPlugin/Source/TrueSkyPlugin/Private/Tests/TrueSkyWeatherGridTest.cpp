@@ -0,0 +1,99 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "AutomationTest.h"
+#include "TrueSkyWeatherGrid.h"
+
+#if PLATFORM_WINDOWS
+/** Writes a one-step grid three rows high, around the equator, whose coverage is Columns[x] down each column. */
+static bool WriteGrid(const FString &Filename,double Longitude0,double DeltaLongitude,const TArray<float> &Columns)
+{
+	FTrueSkyWeatherGridHeader Header;
+	FMemory::Memzero(&Header,sizeof(Header));
+	Header.Magic			=FTrueSkyWeatherGridHeader::MAGIC;
+	Header.Version			=1;
+	Header.Width			=Columns.Num();
+	Header.Height			=3;
+	Header.Steps			=1;
+	Header.Layers			=WEATHER_LAYER_COUNT;
+	Header.Latitude0		=-10.0;
+	Header.Longitude0		=Longitude0;
+	Header.DeltaLatitude	=10.0;
+	Header.DeltaLongitude	=DeltaLongitude;
+	TArray<float> Values;
+	Values.Add(0.0f);
+	Values.AddZeroed(Header.Layers*Header.Width*Header.Height);
+	for(uint32 y=0;y<Header.Height;y++)
+	{
+		for(uint32 x=0;x<Header.Width;x++)
+			Values[1+(WEATHER_LAYER_COVERAGE*Header.Height+y)*Header.Width+x]=Columns[x];
+	}
+	TArray<uint8> File;
+	File.Append((const uint8*)&Header,sizeof(Header));
+	File.Append((const uint8*)Values.GetData(),Values.Num()*sizeof(float));
+	return FFileHelper::SaveArrayToFile(File,*Filename);
+}
+
+/** Coverage of the one texel at the world origin, with the world origin at Longitude on the equator. */
+static float SampleCoverage(const FTrueSkyWeatherGrid &Grid,double Longitude)
+{
+	TArray<FFloat16Color> Texels;
+	Grid.Sample(FDateTime::FromUnixTimestamp(0),0.0,Longitude,FVector2D(-0.5f,-0.5f),1.0f,1,Texels);
+	return Texels[0].R.GetFloat();
+}
+#endif
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrueSkyWeatherGridTest,"TrueSky.WeatherGrid.Antimeridian",EAutomationTestFlags::ATF_Editor)
+
+bool FTrueSkyWeatherGridTest::RunTest(const FString &Parameters)
+{
+#if PLATFORM_WINDOWS
+	FString Filename=FPaths::AutomationTransientDir()/TEXT("TrueSkyWeatherGridTest.tsgrid");
+	// A global grid of 10 degree columns centred on -175 to 175: the last column's neighbour to the east is the first.
+	TArray<float> Columns;
+	Columns.AddZeroed(36);
+	Columns[0]	=0.2f;
+	Columns[35]	=0.8f;
+	if(!WriteGrid(Filename,-175.0,10.0,Columns))
+	{
+		AddError(TEXT("Can't write the test grid"));
+		return false;
+	}
+	{
+		FTrueSkyWeatherGrid Grid;
+		if(Grid.Open(Filename))
+		{
+			TestEqual(TEXT("Global grid at 180"),SampleCoverage(Grid,180.0),0.5f,0.01f);
+			TestEqual(TEXT("Global grid at 179"),SampleCoverage(Grid,179.0),0.56f,0.01f);
+			TestEqual(TEXT("Global grid at -179"),SampleCoverage(Grid,-179.0),0.44f,0.01f);
+			TestEqual(TEXT("Global grid at -180"),SampleCoverage(Grid,-180.0),0.5f,0.01f);
+		}
+		else
+			AddError(TEXT("Can't open the global test grid"));
+	}
+	// A regional grid of 1 degree columns from 170 east to 170 west, across the antimeridian.
+	Columns.Empty(21);
+	for(int32 x=0;x<21;x++)
+		Columns.Add(x/20.0f);
+	if(!WriteGrid(Filename,170.0,1.0,Columns))
+	{
+		AddError(TEXT("Can't write the test grid"));
+		return false;
+	}
+	{
+		FTrueSkyWeatherGrid Grid;
+		if(Grid.Open(Filename))
+		{
+			TestEqual(TEXT("Regional grid at 175"),SampleCoverage(Grid,175.0),0.25f,0.01f);
+			TestEqual(TEXT("Regional grid at -175"),SampleCoverage(Grid,-175.0),0.75f,0.01f);
+			// Outside the grid, each side clamps to its own edge.
+			TestEqual(TEXT("Regional grid west of it"),SampleCoverage(Grid,160.0),0.0f,0.01f);
+			TestEqual(TEXT("Regional grid east of it"),SampleCoverage(Grid,-160.0),1.0f,0.01f);
+		}
+		else
+			AddError(TEXT("Can't open the regional test grid"));
+	}
+	IFileManager::Get().Delete(*Filename);
+#endif
+	return true;
+}
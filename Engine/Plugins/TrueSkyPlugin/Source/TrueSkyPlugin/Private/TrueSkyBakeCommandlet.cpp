@@ -0,0 +1,67 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyBakeCommandlet.h"
+#include "TrueSkySequenceAsset.h"
+#include "TrueSkyCPURenderer.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyBake, Log, All);
+
+UTrueSkyBakeCommandlet::UTrueSkyBakeCommandlet(const class FPostConstructInitializeProperties& PCIP)
+	: Super(PCIP)
+{
+	IsClient	=false;
+	IsServer	=false;
+	IsEditor	=false;
+	LogToConsole=true;
+}
+
+int32 UTrueSkyBakeCommandlet::Main(const FString& Params)
+{
+	FString SequencePath;
+	if(!FParse::Value(*Params,TEXT("Sequence="),SequencePath))
+	{
+		UE_LOG(TrueSkyBake, Error, TEXT("No -Sequence= given"));
+		return 1;
+	}
+	FString TimesText=TEXT("0.5");
+	FParse::Value(*Params,TEXT("Times="),TimesText);
+	int32 Width=1024;
+	FParse::Value(*Params,TEXT("Width="),Width);
+	Width=FMath::Max(8,Width);
+	FString OutDir=FPaths::GameSavedDir()/TEXT("TrueSkyBake");
+	FParse::Value(*Params,TEXT("Out="),OutDir);
+
+	UTrueSkySequenceAsset *Sequence=LoadObject<UTrueSkySequenceAsset>(NULL,*SequencePath);
+	if(!Sequence)
+	{
+		UE_LOG(TrueSkyBake, Error, TEXT("Can't load sequence %s"),*SequencePath);
+		return 1;
+	}
+	ITrueSkyPlugin &TrueSkyPlugin=ITrueSkyPlugin::Get();
+	if(!TrueSkyPlugin.SetSequenceForEvaluation(Sequence))
+	{
+		UE_LOG(TrueSkyBake, Error, TEXT("trueSKY runtime couldn't evaluate %s"),*SequencePath);
+		return 1;
+	}
+	TArray<FString> Times;
+	TimesText.ParseIntoArray(&Times,TEXT(","),true);
+	for(int32 i=0;i<Times.Num();i++)
+	{
+		float Time=FCString::Atof(*Times[i]);
+		TrueSkyPlugin.SetRenderFloat("time",Time);
+		FTrueSkyCPURenderer Renderer(FTrueSkyCPUSkyParameters::FromRuntime(TrueSkyPlugin));
+		TArray<FLinearColor> Pixels;
+		FSHVectorRGB3 SH;
+		Renderer.RenderPanorama(Width,Width/2,Pixels,&SH);
+		FString BaseName=OutDir/FString::Printf(TEXT("%s_%s"),*Sequence->GetName(),*Times[i].Replace(TEXT("."),TEXT("_")));
+		if(!FTrueSkyCPURenderer::SaveHDR(BaseName+TEXT(".hdr"),Width,Width/2,Pixels)
+			||!FTrueSkyCPURenderer::SaveSH(BaseName+TEXT("_sh.txt"),SH))
+		{
+			UE_LOG(TrueSkyBake, Error, TEXT("Failed to write %s"),*BaseName);
+			return 1;
+		}
+		UE_LOG(TrueSkyBake, Display, TEXT("Baked %s at time %s"),*Sequence->GetName(),*Times[i]);
+	}
+	return 0;
+}
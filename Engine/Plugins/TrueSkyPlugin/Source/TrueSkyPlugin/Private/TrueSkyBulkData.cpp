@@ -0,0 +1,57 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyBulkData.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyBulkData, Log, All);
+
+bool FTrueSkyBulkData::Copy(FByteBulkData &BulkData,const FString &Filename,TArray<uint8> &OutData)
+{
+	int32 Size=BulkData.GetBulkDataSize();
+	OutData.Empty(Size);
+	if(Size<=0)
+		return false;
+	// Compressed payloads would need decompressing by the linker that's gone; those stay loaded once they are.
+	bool Reloadable=!Filename.IsEmpty()&&!BulkData.IsStoredCompressedOnDisk()&&BulkData.GetBulkDataOffsetInFile()>=0;
+	if(BulkData.IsBulkDataLoaded())
+	{
+		OutData.AddUninitialized(Size);
+		void *Data=OutData.GetData();
+		// The editor may save over the package, moving the payload, so only cooked data is ever dropped.
+		BulkData.GetCopy(&Data,Reloadable&&FPlatformProperties::RequiresCookedData());
+		return true;
+	}
+	if(!Reloadable)
+	{
+		UE_LOG(TrueSkyBulkData, Warning, TEXT("Bulk data of %d bytes isn't loaded and can't be read back from %s"), Size, Filename.IsEmpty()?TEXT("its package"):*Filename);
+		return false;
+	}
+	FArchive *Reader=IFileManager::Get().CreateFileReader(*Filename,FILEREAD_Silent);
+	if(Reader)
+	{
+		Reader->Seek(BulkData.GetBulkDataOffsetInFile());
+		OutData.AddUninitialized(Size);
+		Reader->Serialize(OutData.GetData(),Size);
+		bool Failed=Reader->IsError();
+		delete Reader;
+		if(!Failed)
+			return true;
+	}
+	UE_LOG(TrueSkyBulkData, Warning, TEXT("Failed to read %d bytes of bulk data back from %s"), Size, *Filename);
+	OutData.Empty();
+	return false;
+}
+
+void FTrueSkyBulkData::Store(FByteBulkData &BulkData,const TArray<uint8> &Data)
+{
+	BulkData.Lock(LOCK_READ_WRITE);
+	FMemory::Memcpy(BulkData.Realloc(Data.Num()),Data.GetData(),Data.Num());
+	BulkData.Unlock();
+}
+
+FString FTrueSkyBulkData::GetPackageFilename(UObject *Owner,FArchive &Ar)
+{
+	if(!Ar.IsLoading()||!Owner->GetLinker())
+		return FString();
+	return Owner->GetLinker()->Filename;
+}
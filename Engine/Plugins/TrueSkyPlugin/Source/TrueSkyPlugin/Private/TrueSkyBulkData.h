@@ -0,0 +1,18 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+/** Bulk data that stays on disk except while it's being copied out, for assets whose payload is only needed a piece at a time. */
+class FTrueSkyBulkData
+{
+public:
+	/**
+	 * Copies bulk data out. Filename is the file it was loaded from, e.g. from GetPackageFilename(), or empty if it wasn't.
+	 * In cooked builds the loaded copy is discarded if it can be read back from there; data that isn't loaded is read from there
+	 * directly, since the package's linker may be long gone. False, having logged why, if it can't be had.
+	 */
+	static bool		Copy(FByteBulkData &BulkData,const FString &Filename,TArray<uint8> &OutData);
+	/** Replaces the bulk data's payload with Data. */
+	static void		Store(FByteBulkData &BulkData,const TArray<uint8> &Data);
+	/** The file Owner is being loaded from, for Copy; empty if it isn't being loaded from a package. Call from Serialize. */
+	static FString	GetPackageFilename(UObject *Owner,FArchive &Ar);
+};
@@ -0,0 +1,627 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyCPURenderer.h"
+#include "TrueSkySequenceActor.h"
+#include "TaskGraphInterfaces.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyCPU, Log, All);
+
+// All distances in km.
+static const float EarthRadius				=6360.0f;
+static const float AtmosphereRadius			=6420.0f;
+static const float RayleighScaleHeight		=8.0f;
+static const float MieScaleHeight			=1.2f;
+static const FLinearColor RayleighScattering(5.8e-3f,13.5e-3f,33.1e-3f);
+static const float MieScattering			=21e-3f;
+static const float MieExtinctionRatio		=1.1f;
+static const float MieG						=0.76f;
+static const float CloudG					=0.6f;
+static const float CloudExtinction			=40.0f;
+static const float GroundAlbedo				=0.1f;
+/** Longest view step, as a fraction of the ray. Cloud is marched finer, and empty bricks skipped up to this. */
+static const int32 ViewSteps				=48;
+/** Cloud steps through the layer's height, and at most per view step. */
+static const int32 CloudViewSteps			=16;
+static const int32 CloudStepsPerViewStep	=4;
+static const int32 MaxViewSteps				=256;
+/** Below this the rest of the ray can't be seen. */
+static const float MinTransmittance			=1e-3f;
+static const int32 SunSteps					=6;
+static const int32 CloudLightSteps			=4;
+static const int32 CloudOctaves				=4;
+static const float CloudOctaveScale			=2.03f;
+static const int32 MaxBricksPerAxis			=256;
+/** Rays traced together: adjacent pixels of a row, whose samples mostly agree on occupancy. */
+static const int32 PacketSize				=4;
+static const int32 OccupancyLayers			=4;
+
+FTrueSkyCPUSkyParameters::FTrueSkyCPUSkyParameters()
+	:SunDirection(0.0f,0.0f,1.0f)
+	,SunIrradiance(1.0f,1.0f,1.0f)
+	,ViewAltitudeKm(0.002f)
+	,CloudCoverage(0.5f)
+	,CloudDensity(1.0f)
+	,CloudBaseKm(1.5f)
+	,CloudHeightKm(2.0f)
+	,CloudScaleKm(8.0f)
+	,CloudOffsetKm(0.0f,0.0f)
+	,HazeDensity(1.0f)
+{
+}
+
+FTrueSkyCPUSkyParameters FTrueSkyCPUSkyParameters::FromRuntime(ITrueSkyPlugin &TrueSkyPlugin)
+{
+	FTrueSkyCPUSkyParameters P;
+	// Towards the sun, against the light.
+	P.SunDirection	=-ATrueSkySequenceActor::GetRuntimeSunRotation(TrueSkyPlugin).Vector();
+	P.SunIrradiance	=FLinearColor(TrueSkyPlugin.GetRenderFloat("SunIrradianceRed")
+								,TrueSkyPlugin.GetRenderFloat("SunIrradianceGreen")
+								,TrueSkyPlugin.GetRenderFloat("SunIrradianceBlue"));
+	P.CloudCoverage	=TrueSkyPlugin.GetRenderFloat("CloudCoverage");
+	P.CloudDensity	=TrueSkyPlugin.GetRenderFloat("CloudDensity");
+	P.CloudBaseKm	=TrueSkyPlugin.GetRenderFloat("CloudBaseKm");
+	P.CloudHeightKm	=TrueSkyPlugin.GetRenderFloat("CloudHeightKm");
+	P.CloudScaleKm	=FMath::Max(0.1f,TrueSkyPlugin.GetRenderFloat("CloudScaleKm"));
+	P.CloudOffsetKm	=FVector2D(TrueSkyPlugin.GetRenderFloat("CloudOffsetXKm"),TrueSkyPlugin.GetRenderFloat("CloudOffsetYKm"));
+	P.HazeDensity	=TrueSkyPlugin.GetRenderFloat("Haze");
+	return P;
+}
+
+/** Distance along a ray from O (|O|<Radius) to the sphere of Radius. */
+static float RayExitSphere(const FVector &O,const FVector &D,float Radius)
+{
+	float b=FVector::DotProduct(O,D);
+	float c=O.SizeSquared()-Radius*Radius;
+	return -b+FMath::Sqrt(FMath::Max(0.0f,b*b-c));
+}
+
+/** Distance along a ray from O (|O|>Radius) to the near side of the sphere of Radius, or -1 if it misses. */
+static float RayHitSphere(const FVector &O,const FVector &D,float Radius)
+{
+	float b=FVector::DotProduct(O,D);
+	float c=O.SizeSquared()-Radius*Radius;
+	float disc=b*b-c;
+	if(disc<0.0f)
+		return -1.0f;
+	float t=-b-FMath::Sqrt(disc);
+	return t>0.0f?t:-1.0f;
+}
+
+static FORCEINLINE float Hash(int32 X,int32 Y,int32 Z)
+{
+	uint32 h=(uint32)X*73856093u^(uint32)Y*19349663u^(uint32)Z*83492791u;
+	h=(h^(h>>13))*0x5bd1e995u;
+	h^=h>>15;
+	return (float)(h&0xffffff)/(float)0xffffff;
+}
+
+/**
+ * Value noise at PacketSize points, structure-of-arrays. Each stage runs across all the lanes before the next,
+ * so the fixed-length lane loops, the integer hash included, can compile to SIMD.
+ */
+static void ValueNoisePacket(const float *X,const float *Y,const float *Z,float *Out)
+{
+	int32 ix[PacketSize],iy[PacketSize],iz[PacketSize];
+	float fx[PacketSize],fy[PacketSize],fz[PacketSize];
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		ix[l]=FMath::FloorToInt(X[l]);
+		iy[l]=FMath::FloorToInt(Y[l]);
+		iz[l]=FMath::FloorToInt(Z[l]);
+	}
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		fx[l]=X[l]-ix[l];
+		fy[l]=Y[l]-iy[l];
+		fz[l]=Z[l]-iz[l];
+		fx[l]=fx[l]*fx[l]*(3.0f-2.0f*fx[l]);
+		fy[l]=fy[l]*fy[l]*(3.0f-2.0f*fy[l]);
+		fz[l]=fz[l]*fz[l]*(3.0f-2.0f*fz[l]);
+	}
+	// The eight lattice corners, corner c at (c&1,(c>>1)&1,c>>2).
+	float h[8][PacketSize];
+	for(int32 c=0;c<8;c++)
+		for(int32 l=0;l<PacketSize;l++)
+			h[c][l]=Hash(ix[l]+(c&1),iy[l]+((c>>1)&1),iz[l]+(c>>2));
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		float x00=h[0][l]+(h[1][l]-h[0][l])*fx[l];
+		float x10=h[2][l]+(h[3][l]-h[2][l])*fx[l];
+		float x01=h[4][l]+(h[5][l]-h[4][l])*fx[l];
+		float x11=h[6][l]+(h[7][l]-h[6][l])*fx[l];
+		float y0=x00+(x10-x00)*fy[l];
+		float y1=x01+(x11-x01)*fy[l];
+		Out[l]=y0+(y1-y0)*fz[l];
+	}
+}
+
+static FORCEINLINE float HenyeyGreenstein(float g,float CosTheta)
+{
+	float g2=g*g;
+	return (1.0f-g2)/(4.0f*PI*FMath::Pow(FMath::Max(1e-4f,1.0f+g2-2.0f*g*CosTheta),1.5f));
+}
+
+/** Upper bound of ValueNoise over a box: the noise is a convex blend of the hashes at the surrounding lattice points. */
+static float ValueNoiseMax(const FVector &Min,const FVector &Max)
+{
+	int32 x0=FMath::FloorToInt(Min.X),y0=FMath::FloorToInt(Min.Y),z0=FMath::FloorToInt(Min.Z);
+	int32 x1=FMath::FloorToInt(Max.X)+1,y1=FMath::FloorToInt(Max.Y)+1,z1=FMath::FloorToInt(Max.Z)+1;
+	float m=0.0f;
+	for(int32 z=z0;z<=z1;z++)
+		for(int32 y=y0;y<=y1;y++)
+			for(int32 x=x0;x<=x1;x++)
+				m=FMath::Max(m,Hash(x,y,z));
+	return m;
+}
+
+FTrueSkyCPURenderer::FTrueSkyCPURenderer(const FTrueSkyCPUSkyParameters &InParameters)
+	:Parameters(InParameters)
+{
+	Parameters.SunDirection.Normalize();
+	BuildOccupancy();
+}
+
+void FTrueSkyCPURenderer::BuildOccupancy()
+{
+	double StartTime=FPlatformTime::Seconds();
+	// Cover everything in the layer the viewer can see: out to the horizon and the layer top's horizon beyond it.
+	float top		=Parameters.CloudBaseKm+Parameters.CloudHeightKm;
+	float viewR		=EarthRadius+FMath::Max(0.0f,Parameters.ViewAltitudeKm);
+	float extent	=FMath::Sqrt(viewR*viewR-EarthRadius*EarthRadius)+FMath::Sqrt((EarthRadius+top)*(EarthRadius+top)-EarthRadius*EarthRadius);
+	BrickSizeKm		=FMath::Max(0.5f*Parameters.CloudScaleKm,2.0f*extent/(float)MaxBricksPerAxis);
+	BrickHeightKm	=FMath::Max(0.01f,Parameters.CloudHeightKm)/(float)OccupancyLayers;
+	BricksX=BricksY	=FMath::CeilToInt(2.0f*extent/BrickSizeKm);
+	BricksZ			=OccupancyLayers;
+	OccupancyOrigin	=FVector2D(-0.5f*BricksX*BrickSizeKm,-0.5f*BricksY*BrickSizeKm);
+	Occupancy.Empty(BricksX*BricksY*BricksZ);
+	Occupancy.AddZeroed(BricksX*BricksY*BricksZ);
+	float s			=1.0f/Parameters.CloudScaleKm;
+	float coverage	=FMath::Max(0.01f,Parameters.CloudCoverage);
+	int32 occupied	=0;
+	for(int32 k=0;k<BricksZ;k++)
+	{
+		// Largest value of the profile over the brick's heights.
+		float h0=(float)k/(float)BricksZ,h1=(float)(k+1)/(float)BricksZ;
+		float hMax=FMath::Clamp(0.5f,h0,h1);
+		float profile=FMath::Clamp(4.0f*hMax*(1.0f-hMax),0.0f,1.0f);
+		for(int32 j=0;j<BricksY;j++)
+		{
+			for(int32 i=0;i<BricksX;i++)
+			{
+				FVector Min((OccupancyOrigin.X+i*BrickSizeKm+Parameters.CloudOffsetKm.X)*s
+							,(OccupancyOrigin.Y+j*BrickSizeKm+Parameters.CloudOffsetKm.Y)*s
+							,(Parameters.CloudBaseKm+k*BrickHeightKm)*s);
+				FVector Max=Min+FVector(BrickSizeKm,BrickSizeKm,BrickHeightKm)*s;
+				// The two coarse octaves are bounded from the lattice; the finer ones would need too many points, so take their amplitude.
+				float n=0.0f,amp=0.5f;
+				for(int32 o=0;o<CloudOctaves;o++)
+				{
+					n+=amp*(o<2?ValueNoiseMax(Min,Max):1.0f);
+					Min*=CloudOctaveScale;Max*=CloudOctaveScale;
+					amp*=0.5f;
+				}
+				if(n*profile>1.0f-coverage)
+				{
+					Occupancy[(k*BricksY+j)*BricksX+i]=1;
+					occupied++;
+				}
+			}
+		}
+	}
+	// Columns wide enough to hold a whole sun ray through the layer, so an empty neighbourhood means no cloud shadow.
+	ColumnBricks	=FMath::Max(2,FMath::CeilToInt(2.0f*Parameters.CloudHeightKm/BrickSizeKm));
+	ColumnsX		=(BricksX+ColumnBricks-1)/ColumnBricks;
+	ColumnsY		=(BricksY+ColumnBricks-1)/ColumnBricks;
+	TArray<uint8> Columns;
+	Columns.AddZeroed(ColumnsX*ColumnsY);
+	for(int32 k=0;k<BricksZ;k++)
+		for(int32 j=0;j<BricksY;j++)
+			for(int32 i=0;i<BricksX;i++)
+				Columns[(j/ColumnBricks)*ColumnsX+i/ColumnBricks]|=Occupancy[(k*BricksY+j)*BricksX+i];
+	ColumnOccupancy.Empty(ColumnsX*ColumnsY);
+	ColumnOccupancy.AddZeroed(ColumnsX*ColumnsY);
+	for(int32 j=0;j<ColumnsY;j++)
+		for(int32 i=0;i<ColumnsX;i++)
+			for(int32 dj=FMath::Max(0,j-1);dj<=FMath::Min(ColumnsY-1,j+1);dj++)
+				for(int32 di=FMath::Max(0,i-1);di<=FMath::Min(ColumnsX-1,i+1);di++)
+					ColumnOccupancy[j*ColumnsX+i]|=Columns[dj*ColumnsX+di];
+	UE_LOG(TrueSkyCPU,Log,TEXT("Cloud occupancy: %d of %d bricks of %.1f km occupied, built in %.3f s"),occupied,Occupancy.Num(),BrickSizeKm,FPlatformTime::Seconds()-StartTime);
+}
+
+bool FTrueSkyCPURenderer::IsOccupied(float X,float Y,float Z) const
+{
+	int32 i=FMath::FloorToInt((X-OccupancyOrigin.X)/BrickSizeKm);
+	int32 j=FMath::FloorToInt((Y-OccupancyOrigin.Y)/BrickSizeKm);
+	int32 k=FMath::FloorToInt((Z-Parameters.CloudBaseKm)/BrickHeightKm);
+	// Outside the volume nothing is known, so march as before.
+	if(i<0||j<0||i>=BricksX||j>=BricksY)
+		return true;
+	if(k<0||k>=BricksZ)
+		return false;
+	return Occupancy[(k*BricksY+j)*BricksX+i]!=0;
+}
+
+bool FTrueSkyCPURenderer::IsColumnOccupied(float X,float Y) const
+{
+	int32 i=FMath::FloorToInt((X-OccupancyOrigin.X)/BrickSizeKm);
+	int32 j=FMath::FloorToInt((Y-OccupancyOrigin.Y)/BrickSizeKm);
+	if(i<0||j<0||i>=BricksX||j>=BricksY)
+		return true;
+	return ColumnOccupancy[(j/ColumnBricks)*ColumnsX+i/ColumnBricks]!=0;
+}
+
+void FTrueSkyCPURenderer::CloudDensityPacket(const float *X,const float *Y,const float *Z,const bool *Active,float *Out) const
+{
+	float h[PacketSize];
+	bool Needed[PacketSize];
+	bool AnyNeeded=false;
+	float rcpHeight=1.0f/FMath::Max(0.01f,Parameters.CloudHeightKm);
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		h[l]		=(Z[l]-Parameters.CloudBaseKm)*rcpHeight;
+		Needed[l]	=Active[l]&&h[l]>0.0f&&h[l]<1.0f&&IsOccupied(X[l],Y[l],Z[l]);
+		AnyNeeded	|=Needed[l];
+	}
+	if(!AnyNeeded)
+	{
+		for(int32 l=0;l<PacketSize;l++)
+			Out[l]=0.0f;
+		return;
+	}
+	// The noise runs on every lane once any needs it; the lanes that don't are masked out at the end.
+	float s=1.0f/Parameters.CloudScaleKm;
+	float x[PacketSize],y[PacketSize],z[PacketSize],n[PacketSize],v[PacketSize];
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		x[l]=(X[l]+Parameters.CloudOffsetKm.X)*s;
+		y[l]=(Y[l]+Parameters.CloudOffsetKm.Y)*s;
+		z[l]=Z[l]*s;
+		n[l]=0.0f;
+	}
+	float amp=0.5f;
+	for(int32 o=0;o<CloudOctaves;o++)
+	{
+		ValueNoisePacket(x,y,z,v);
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			n[l]+=amp*v[l];
+			x[l]*=CloudOctaveScale;
+			y[l]*=CloudOctaveScale;
+			z[l]*=CloudOctaveScale;
+		}
+		amp*=0.5f;
+	}
+	// Rounded bottoms and tops, then coverage as a threshold on the noise.
+	float threshold	=1.0f-Parameters.CloudCoverage;
+	float rcpCoverage=1.0f/FMath::Max(0.01f,Parameters.CloudCoverage);
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		float profile=FMath::Clamp(4.0f*h[l]*(1.0f-h[l]),0.0f,1.0f);
+		float d=FMath::Clamp((n[l]*profile-threshold)*rcpCoverage,0.0f,1.0f);
+		Out[l]=Needed[l]?d:0.0f;
+	}
+}
+
+float FTrueSkyCPURenderer::GetViewStep(const FVector &Position,const FVector &Direction,float MaxStep,float CloudStep) const
+{
+	static const float Epsilon=1e-3f;
+	float alt	=Position.Size()-EarthRadius;
+	float base	=Parameters.CloudBaseKm;
+	float top	=base+Parameters.CloudHeightKm;
+	// Outside the layer: the atmosphere's step, but stopping where the ray enters the layer.
+	if(alt<base)
+		return FMath::Min(MaxStep,RayExitSphere(Position,Direction,EarthRadius+base)+Epsilon);
+	if(alt>=top)
+	{
+		float d=RayHitSphere(Position,Direction,EarthRadius+top);
+		return d>0.0f?FMath::Min(MaxStep,d+Epsilon):MaxStep;
+	}
+	if(IsOccupied(Position.X,Position.Y,alt))
+		return FMath::Min(MaxStep,CloudStep);
+	// In an empty brick: look ahead by brick lookups alone, to just short of the first occupied brick or out of the layer.
+	float probe=0.5f*FMath::Min(BrickSizeKm,BrickHeightKm);
+	float d=0.0f;
+	while(d<MaxStep)
+	{
+		d+=probe;
+		FVector q=Position+Direction*d;
+		float qalt=q.Size()-EarthRadius;
+		if(qalt<base||qalt>=top)
+			return FMath::Min(MaxStep,d);
+		if(IsOccupied(q.X,q.Y,qalt))
+			return FMath::Max(probe,d-probe);
+	}
+	return MaxStep;
+}
+
+FLinearColor FTrueSkyCPURenderer::SunTransmittance(const FVector &Position) const
+{
+	const FVector &L=Parameters.SunDirection;
+	if(RayHitSphere(Position,L,EarthRadius)>0.0f)
+		return FLinearColor::Black;
+	float dt=RayExitSphere(Position,L,AtmosphereRadius)/(float)SunSteps;
+	float odR=0.0f,odM=0.0f;
+	for(int32 i=0;i<SunSteps;i++)
+	{
+		float alt=(Position+L*((i+0.5f)*dt)).Size()-EarthRadius;
+		odR+=FMath::Exp(-alt/RayleighScaleHeight)*dt;
+		odM+=FMath::Exp(-alt/MieScaleHeight)*dt;
+	}
+	odM*=MieScattering*MieExtinctionRatio*Parameters.HazeDensity;
+	return FLinearColor(FMath::Exp(-RayleighScattering.R*odR-odM)
+						,FMath::Exp(-RayleighScattering.G*odR-odM)
+						,FMath::Exp(-RayleighScattering.B*odR-odM));
+}
+
+void FTrueSkyCPURenderer::CloudSunTransmittancePacket(const FVector *Positions,const bool *Active,float *Out) const
+{
+	const FVector &L=Parameters.SunDirection;
+	bool Marching[PacketSize];
+	bool AnyMarching=false;
+	float dt[PacketSize],od[PacketSize];
+	float top=EarthRadius+Parameters.CloudBaseKm+Parameters.CloudHeightKm;
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		Out[l]		=Active[l]&&L.Z<=0.0f?0.0f:1.0f;
+		od[l]		=0.0f;
+		Marching[l]	=Active[l]&&L.Z>0.0f&&IsColumnOccupied(Positions[l].X,Positions[l].Y);
+		dt[l]		=Marching[l]?FMath::Min(RayExitSphere(Positions[l],L,top),2.0f*Parameters.CloudHeightKm)/(float)CloudLightSteps:0.0f;
+		AnyMarching	|=Marching[l];
+	}
+	if(!AnyMarching)
+		return;
+	float X[PacketSize],Y[PacketSize],Z[PacketSize],d[PacketSize];
+	for(int32 i=0;i<CloudLightSteps;i++)
+	{
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			FVector p=Positions[l]+L*((i+0.5f)*dt[l]);
+			X[l]=p.X;
+			Y[l]=p.Y;
+			Z[l]=p.Size()-EarthRadius;
+		}
+		CloudDensityPacket(X,Y,Z,Marching,d);
+		for(int32 l=0;l<PacketSize;l++)
+			od[l]+=d[l]*dt[l];
+	}
+	float k=CloudExtinction*Parameters.CloudDensity;
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		if(Marching[l])
+			Out[l]=FMath::Exp(-od[l]*k);
+	}
+}
+
+void FTrueSkyCPURenderer::TracePacket(const FVector *Directions,int32 Count,FLinearColor *OutRadiance) const
+{
+	check(Count<=PacketSize);
+	const FVector Origin(0.0f,0.0f,EarthRadius+Parameters.ViewAltitudeKm);
+	const FVector &L=Parameters.SunDirection;
+	const FLinearColor &Sun=Parameters.SunIrradiance;
+	// Skylight on the clouds: a blue-ish fraction of the sunlight, fading out at night.
+	const FLinearColor Ambient=FLinearColor(0.6f,0.8f,1.0f)*Sun*(0.15f*FMath::Max(0.05f,L.Z));
+	const float CloudTop=Parameters.CloudBaseKm+Parameters.CloudHeightKm;
+	// Lanes past Count repeat the last ray, so they take the same branches, and are dropped at the end.
+	FVector D[PacketSize];
+	bool Active[PacketSize];
+	float tGround[PacketSize],tMax[PacketSize],t[PacketSize],dt[PacketSize],maxStep[PacketSize],cloudStep[PacketSize];
+	float phaseR[PacketSize],phaseM[PacketSize],phaseC[PacketSize];
+	FLinearColor T[PacketSize],S[PacketSize];
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		D[l]		=Directions[FMath::Min(l,Count-1)];
+		Active[l]	=true;
+		tGround[l]	=RayHitSphere(Origin,D[l],EarthRadius);
+		tMax[l]		=tGround[l]>0.0f?tGround[l]:RayExitSphere(Origin,D[l],AtmosphereRadius);
+		t[l]		=0.0f;
+		maxStep[l]	=tMax[l]/(float)ViewSteps;
+		cloudStep[l]=FMath::Max(Parameters.CloudHeightKm/(float)CloudViewSteps,maxStep[l]/(float)CloudStepsPerViewStep);
+		float mu	=FVector::DotProduct(D[l],L);
+		phaseR[l]	=3.0f/(16.0f*PI)*(1.0f+mu*mu);
+		phaseM[l]	=HenyeyGreenstein(MieG,mu);
+		phaseC[l]	=HenyeyGreenstein(CloudG,mu);
+		T[l]		=FLinearColor(1.0f,1.0f,1.0f);
+		S[l]		=FLinearColor(0.0f,0.0f,0.0f);
+	}
+	FVector p[PacketSize];
+	float X[PacketSize],Y[PacketSize],alt[PacketSize],rhoR[PacketSize],rhoM[PacketSize],cloud[PacketSize],cloudSunT[PacketSize];
+	bool NeedsCloudShadow[PacketSize];
+	for(int32 s=0;s<MaxViewSteps;s++)
+	{
+		// Each ray picks its own step; rays that have finished take none, and add nothing.
+		bool AnyActive=false;
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			dt[l]	=Active[l]?FMath::Min(GetViewStep(Origin+D[l]*t[l],D[l],maxStep[l],cloudStep[l]),tMax[l]-t[l]):0.0f;
+			p[l]	=Origin+D[l]*(t[l]+0.5f*dt[l]);
+			AnyActive|=Active[l];
+		}
+		if(!AnyActive)
+			break;
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			X[l]	=p[l].X;
+			Y[l]	=p[l].Y;
+			alt[l]	=p[l].Size()-EarthRadius;
+		}
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			rhoR[l]=FMath::Exp(-alt[l]/RayleighScaleHeight);
+			rhoM[l]=FMath::Exp(-alt[l]/MieScaleHeight)*Parameters.HazeDensity;
+		}
+		CloudDensityPacket(X,Y,alt,Active,cloud);
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			cloud[l]			*=Parameters.CloudDensity*CloudExtinction;
+			NeedsCloudShadow[l]	=Active[l]&&(cloud[l]>0.0f||alt[l]<CloudTop);
+		}
+		CloudSunTransmittancePacket(p,NeedsCloudShadow,cloudSunT);
+		for(int32 l=0;l<PacketSize;l++)
+		{
+			if(!Active[l])
+				continue;
+			FLinearColor sunT=SunTransmittance(p[l])*cloudSunT[l];
+			float mie=MieScattering*rhoM[l];
+			FLinearColor scatter=(RayleighScattering*(rhoR[l]*phaseR[l])+FLinearColor(1.0f,1.0f,1.0f)*(mie*phaseM[l]+cloud[l]*phaseC[l]))*sunT*Sun+Ambient*cloud[l];
+			FLinearColor ext=RayleighScattering*rhoR[l]+FLinearColor(1.0f,1.0f,1.0f)*(mie*MieExtinctionRatio+cloud[l]);
+			S[l]+=T[l]*scatter*dt[l];
+			T[l].R*=FMath::Exp(-ext.R*dt[l]);
+			T[l].G*=FMath::Exp(-ext.G*dt[l]);
+			T[l].B*=FMath::Exp(-ext.B*dt[l]);
+			t[l]+=dt[l];
+			Active[l]=t[l]<tMax[l]*0.9999f&&FMath::Max3(T[l].R,T[l].G,T[l].B)>MinTransmittance;
+		}
+	}
+	// Sunlight off the ground, for the rays that hit it.
+	bool HitGround[PacketSize];
+	FVector n[PacketSize];
+	for(int32 l=0;l<PacketSize;l++)
+	{
+		HitGround[l]=tGround[l]>0.0f;
+		n[l]		=(Origin+D[l]*FMath::Max(0.0f,tGround[l])).SafeNormal();
+		p[l]		=n[l]*(EarthRadius+0.001f);
+	}
+	CloudSunTransmittancePacket(p,HitGround,cloudSunT);
+	for(int32 l=0;l<Count;l++)
+	{
+		FLinearColor C(S[l].R,S[l].G,S[l].B);
+		if(HitGround[l])
+		{
+			float lambert=FMath::Max(0.0f,FVector::DotProduct(n[l],L))*GroundAlbedo/PI;
+			C+=FLinearColor(T[l].R,T[l].G,T[l].B)*SunTransmittance(p[l])*cloudSunT[l]*Sun*lambert;
+		}
+		C.A=1.0f;
+		OutRadiance[l]=C;
+	}
+}
+
+void FTrueSkyCPURenderer::RenderTile(FTrueSkyCPUTile &Tile,int32 Width,int32 Height,FLinearColor *Pixels) const
+{
+	Tile.SH=FSHVectorRGB3();
+	const float dPhi=2.0f*PI/(float)Width;
+	const float dTheta=PI/(float)Height;
+	FVector Dirs[PacketSize];
+	FLinearColor Radiance[PacketSize];
+	for(int32 y=Tile.Y;y<Tile.Y+Tile.H;y++)
+	{
+		float theta=(y+0.5f)*dTheta;
+		float sinTheta=FMath::Sin(theta),cosTheta=FMath::Cos(theta);
+		float solidAngle=dPhi*dTheta*sinTheta;
+		for(int32 x0=Tile.X;x0<Tile.X+Tile.W;x0+=PacketSize)
+		{
+			int32 Count=FMath::Min(PacketSize,Tile.X+Tile.W-x0);
+			for(int32 l=0;l<Count;l++)
+			{
+				float phi=(x0+l+0.5f)*dPhi;
+				Dirs[l]=FVector(sinTheta*FMath::Cos(phi),sinTheta*FMath::Sin(phi),cosTheta);
+			}
+			TracePacket(Dirs,Count,Radiance);
+			for(int32 l=0;l<Count;l++)
+			{
+				Pixels[y*Width+x0+l]=Radiance[l];
+				FSHVector3 Basis=FSHVector3::SHBasisFunction(Dirs[l]);
+				Tile.SH.R+=Basis*(Radiance[l].R*solidAngle);
+				Tile.SH.G+=Basis*(Radiance[l].G*solidAngle);
+				Tile.SH.B+=Basis*(Radiance[l].B*solidAngle);
+			}
+		}
+	}
+}
+
+/** Renders one tile on a task graph worker. */
+class FTrueSkyCPUTileTask
+{
+	const FTrueSkyCPURenderer &Renderer;
+	FTrueSkyCPUTile &Tile;
+	int32 Width,Height;
+	FLinearColor *Pixels;
+
+public:
+	FTrueSkyCPUTileTask(const FTrueSkyCPURenderer &InRenderer,FTrueSkyCPUTile &InTile,int32 InWidth,int32 InHeight,FLinearColor *InPixels)
+		:Renderer(InRenderer)
+		,Tile(InTile)
+		,Width(InWidth)
+		,Height(InHeight)
+		,Pixels(InPixels)
+	{
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FTrueSkyCPUTileTask, STATGROUP_TaskGraphTasks);
+	}
+
+	ENamedThreads::Type GetDesiredThread()
+	{
+		return ENamedThreads::AnyThread;
+	}
+
+	static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::TrackSubsequents; }
+
+	void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		Renderer.RenderTile(Tile,Width,Height,Pixels);
+	}
+};
+
+void FTrueSkyCPURenderer::RenderPanorama(int32 Width,int32 Height,TArray<FLinearColor> &OutPixels,FSHVectorRGB3 *OutSH,int32 TileSize) const
+{
+	OutPixels.Empty(Width*Height);
+	OutPixels.AddZeroed(Width*Height);
+	TArray<FTrueSkyCPUTile> Tiles;
+	for(int32 y=0;y<Height;y+=TileSize)
+	{
+		for(int32 x=0;x<Width;x+=TileSize)
+		{
+			FTrueSkyCPUTile Tile;
+			Tile.X=x;
+			Tile.Y=y;
+			Tile.W=FMath::Min(TileSize,Width-x);
+			Tile.H=FMath::Min(TileSize,Height-y);
+			Tiles.Add(Tile);
+		}
+	}
+	double StartTime=FPlatformTime::Seconds();
+	FGraphEventArray Events;
+	for(int32 i=0;i<Tiles.Num();i++)
+	{
+		Events.Add(TGraphTask<FTrueSkyCPUTileTask>::CreateTask().ConstructAndDispatchWhenReady(*this,Tiles[i],Width,Height,OutPixels.GetData()));
+	}
+	FTaskGraphInterface::Get().WaitUntilTasksComplete(Events,ENamedThreads::GameThread);
+	if(OutSH)
+	{
+		*OutSH=FSHVectorRGB3();
+		for(int32 i=0;i<Tiles.Num();i++)
+			*OutSH+=Tiles[i].SH;
+	}
+	UE_LOG(TrueSkyCPU,Log,TEXT("Rendered %dx%d panorama in %d tiles, %.2f s"),Width,Height,Tiles.Num(),FPlatformTime::Seconds()-StartTime);
+}
+
+bool FTrueSkyCPURenderer::SaveHDR(const FString &Filename,int32 Width,int32 Height,const TArray<FLinearColor> &Pixels)
+{
+	TArray<uint8> Bytes;
+	FString Header=FString::Printf(TEXT("#?RADIANCE\nFORMAT=32-bit_rle_rgbe\n\n-Y %d +X %d\n"),Height,Width);
+	Bytes.Reserve(Header.Len()+Width*Height*4);
+	for(int32 i=0;i<Header.Len();i++)
+		Bytes.Add((uint8)Header[i]);
+	for(int32 i=0;i<Pixels.Num();i++)
+	{
+		FColor RGBE=Pixels[i].ToRGBE();
+		Bytes.Add(RGBE.R);
+		Bytes.Add(RGBE.G);
+		Bytes.Add(RGBE.B);
+		Bytes.Add(RGBE.A);
+	}
+	return FFileHelper::SaveArrayToFile(Bytes,*Filename);
+}
+
+bool FTrueSkyCPURenderer::SaveSH(const FString &Filename,const FSHVectorRGB3 &SH)
+{
+	FString Text;
+	for(int32 i=0;i<FSHVector3::NumTotalFloats;i++)
+	{
+		Text+=FString::Printf(TEXT("%f %f %f\n"),SH.R.V[i],SH.G.V[i],SH.B.V[i]);
+	}
+	return FFileHelper::SaveStringToFile(Text,*Filename);
+}
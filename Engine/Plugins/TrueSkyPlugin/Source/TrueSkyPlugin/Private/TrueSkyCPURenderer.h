@@ -0,0 +1,92 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+#include "SHMath.h"
+
+/** The sky state the CPU renderer evaluates, taken from the runtime's current (sequence-driven) values. */
+struct FTrueSkyCPUSkyParameters
+{
+	FTrueSkyCPUSkyParameters();
+
+	/** Reads the runtime's current values, i.e. the active sequence at the current time. */
+	static FTrueSkyCPUSkyParameters FromRuntime(class ITrueSkyPlugin &TrueSkyPlugin);
+
+	/** Unit vector towards the sun, Unreal axes (Z up). */
+	FVector		SunDirection;
+	FLinearColor SunIrradiance;
+	float		ViewAltitudeKm;
+	float		CloudCoverage;
+	float		CloudDensity;
+	float		CloudBaseKm;
+	float		CloudHeightKm;
+	float		CloudScaleKm;
+	FVector2D	CloudOffsetKm;
+	float		HazeDensity;
+};
+
+/** A block of pixels rendered by one task. */
+struct FTrueSkyCPUTile
+{
+	int32			X,Y,W,H;
+	/** Radiance projected onto SH over this tile, summed by the caller. */
+	FSHVectorRGB3	SH;
+};
+
+/**
+ * Reference (non-real-time) CPU implementation of the sky and cloud evaluation, for
+ * baking panoramas, thumbnails and SH lighting on machines without a GPU.
+ * Image tiles are spread over the task graph, so it scales with the number of cores, and each
+ * tile's rays are traced in packets of adjacent pixels, vectorized across the packet.
+ */
+class FTrueSkyCPURenderer
+{
+public:
+	FTrueSkyCPURenderer(const FTrueSkyCPUSkyParameters &InParameters);
+
+	/** Renders an equirectangular panorama (Width x Height, Z up). If OutSH is non-null the radiance is also projected onto it. */
+	void			RenderPanorama(int32 Width,int32 Height,TArray<FLinearColor> &OutPixels,FSHVectorRGB3 *OutSH=NULL,int32 TileSize=32) const;
+
+	/** Renders one tile of the panorama into Pixels (the full image). Safe to call from any thread. */
+	void			RenderTile(FTrueSkyCPUTile &Tile,int32 Width,int32 Height,FLinearColor *Pixels) const;
+
+	/** Writes Radiance RGBE (.hdr). */
+	static bool		SaveHDR(const FString &Filename,int32 Width,int32 Height,const TArray<FLinearColor> &Pixels);
+	/** Writes the 9 RGB coefficients of the SH as text, one coefficient per line. */
+	static bool		SaveSH(const FString &Filename,const FSHVectorRGB3 &SH);
+
+protected:
+	/**
+	 * Traces a packet of Count (up to four) rays from the viewer, returning their radiance. The rays march in step,
+	 * their density, noise and shadowing evaluated across the packet, structure-of-arrays.
+	 */
+	void			TracePacket(const FVector *Directions,int32 Count,FLinearColor *OutRadiance) const;
+	/** Cloud density (0-1) at a packet of positions in km, relative to the viewer's ground point; zero where Active is false. */
+	void			CloudDensityPacket(const float *X,const float *Y,const float *Z,const bool *Active,float *Out) const;
+	/** Builds the occupancy bricks from an upper bound of the noise over each, so empty space skips the noise. */
+	void			BuildOccupancy();
+	/** False where the cloud density is certainly zero. */
+	bool			IsOccupied(float X,float Y,float Z) const;
+	/**
+	 * Length of the next view step from Position: CloudStep in occupied bricks, MaxStep outside the layer (stopping
+	 * at its edge), and across empty bricks in one step, as far as the next occupied brick but no more than MaxStep.
+	 */
+	float			GetViewStep(const FVector &Position,const FVector &Direction,float MaxStep,float CloudStep) const;
+	/** False if the whole column of cloud layer within ColumnSizeKm of (X,Y) is empty. */
+	bool			IsColumnOccupied(float X,float Y) const;
+	/** Atmospheric transmittance from a position (km, from the planet centre) towards the sun. */
+	FLinearColor	SunTransmittance(const FVector &Position) const;
+	/** Cloud transmittance from a packet of positions (km, from the planet centre) towards the sun; one where Active is false. */
+	void			CloudSunTransmittancePacket(const FVector *Positions,const bool *Active,float *Out) const;
+
+	FTrueSkyCPUSkyParameters Parameters;
+
+	/** Occupancy of bricks of the cloud layer, BricksX*BricksY*BricksZ, X fastest. */
+	TArray<uint8>	Occupancy;
+	/** Coarser level: one per column of ColumnBricks x ColumnBricks bricks over the layer's height, dilated by one. */
+	TArray<uint8>	ColumnOccupancy;
+	FVector2D		OccupancyOrigin;
+	float			BrickSizeKm;
+	float			BrickHeightKm;
+	int32			BricksX,BricksY,BricksZ;
+	int32			ColumnBricks,ColumnsX,ColumnsY;
+};
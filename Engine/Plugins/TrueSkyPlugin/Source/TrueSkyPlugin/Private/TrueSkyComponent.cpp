@@ -1,23 +1,83 @@
+
 #include "TrueSkyPluginPrivatePCH.h"
 #include "TrueSkyComponent.h"
+#include "TrueSkySequenceAsset.h"
+#include "SkyCrossThreadSnapshot.h"
 
-UTrueSkyComponent::UTrueSkyComponent(const class FPostConstructInitializeProperties& PCIP):Super(PCIP)
+UTrueSkyComponent::UTrueSkyComponent(const class FPostConstructInitializeProperties& PCIP)
+	:Super(PCIP)
+	,SentSequence(NULL)
 {
+	PrimaryComponentTick.bCanEverTick=false;
 }
 
-void UTrueSkyComponent::OnRegister()
+void UTrueSkyComponent::PropertiesChanged()
 {
+	if(!bRenderStateCreated)
+		return;
+	if(FMemory::Memcmp(&Properties,&SentProperties,sizeof(Properties))!=0||GetSkyCrossThreadSnapshot().SequenceTextNeeded)
+		MarkRenderDynamicDataDirty();
 }
 
-void UTrueSkyComponent::InitializeComponent()
+void UTrueSkyComponent::SetSequenceWindow(int32 Window,TArray<uint8> &Text)
 {
+	Properties.SequenceWindow=Window;
+	Exchange(WindowText,Text);
+	if(Window==INDEX_NONE)
+		WindowText.Empty();
+	PropertiesChanged();
 }
 
-void UTrueSkyComponent::TickComponent(float DeltaTime, enum ELevelTick TickType, FActorComponentTickFunction *ThisTickFunction)
+bool UTrueSkyComponent::ShouldCreateRenderState() const
 {
+	return true;
 }
 
-void UTrueSkyComponent::OnUnregister()
+FTrueSkyRenderProxy *UTrueSkyComponent::CreateRenderProxy(bool WithSequenceText)
 {
+	FMemory::Memcpy(&SentProperties,&Properties,sizeof(Properties));
+	FTrueSkyRenderProxy *Proxy=new FTrueSkyRenderProxy;
+	Proxy->Properties=Properties;
+	SentSequence=Properties.activeSequence;
+	if(WithSequenceText&&Properties.SequenceWindow!=INDEX_NONE)
+		Proxy->SequenceText=WindowText;
+	else if(WithSequenceText&&SentSequence)
+		SentSequence->GetSequenceText(Proxy->SequenceText);
+	return Proxy;
 }
 
+void UTrueSkyComponent::CreateRenderState_Concurrent()
+{
+	Super::CreateRenderState_Concurrent();
+	FTrueSkyRenderProxy *Proxy=CreateRenderProxy(true);
+	ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+		FCreateTrueSkyRenderProxy,
+		FTrueSkyRenderProxy*,Proxy,Proxy,
+	{
+		SetTrueSkyRenderProxy(Proxy);
+	});
+}
+
+void UTrueSkyComponent::SendRenderDynamicData_Concurrent()
+{
+	Super::SendRenderDynamicData_Concurrent();
+	bool SequenceChanged=Properties.activeSequence!=SentSequence||Properties.SequenceWindow!=SentProperties.SequenceWindow;
+	FTrueSkyRenderProxy *Proxy=CreateRenderProxy(SequenceChanged||GetSkyCrossThreadSnapshot().SequenceTextNeeded);
+	ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+		FUpdateTrueSkyRenderProxy,
+		FTrueSkyRenderProxy*,Proxy,Proxy,
+	{
+		SetTrueSkyRenderProxy(Proxy);
+	});
+}
+
+void UTrueSkyComponent::DestroyRenderState_Concurrent()
+{
+	Super::DestroyRenderState_Concurrent();
+	ENQUEUE_UNIQUE_RENDER_COMMAND(
+		FDestroyTrueSkyRenderProxy,
+	{
+		SetTrueSkyRenderProxy(NULL);
+	});
+	SentSequence=NULL;
+}
@@ -0,0 +1,180 @@
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyCoverageMapAsset.h"
+#include "TrueSkyBulkData.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyCoverageMap, Log, All);
+
+/** Versions of what the coverage map serializes after its properties. */
+struct FTrueSkyCoverageMapVersion
+{
+	enum Type
+	{
+		/** Nothing after the properties: the tiles are rebuilt from the source texture. */
+		BeforeCustomVersionWasAdded=0,
+		/** The tile count, then each tile's bulk data. */
+		BulkDataTiles,
+
+		VersionPlusOne,
+		LatestVersion=VersionPlusOne-1
+	};
+	static const FGuid GUID;
+};
+
+const FGuid FTrueSkyCoverageMapVersion::GUID(0x5A3C9E41,0x1B7F4D62,0x9C08E2A7,0x43D5F1B9);
+static FCustomVersionRegistration GRegisterTrueSkyCoverageMapVersion(FTrueSkyCoverageMapVersion::GUID,FTrueSkyCoverageMapVersion::LatestVersion,TEXT("TrueSkyCoverageMap"));
+
+UTrueSkyCoverageMapAsset::UTrueSkyCoverageMapAsset(const class FPostConstructInitializeProperties& PCIP)
+	: Super(PCIP)
+#if WITH_EDITORONLY_DATA
+	,SourceTexture(NULL)
+#endif
+	,WorldOrigin(-800000.0f,-800000.0f)
+	,WorldSize(1600000.0f)
+	,DefaultCoverage(0.5f)
+	,DefaultHumidity(0.5f)
+	,TileSize(64)
+	,Resolution(0)
+{
+}
+
+int32 UTrueSkyCoverageMapAsset::GetTilesPerSide(int32 Mip) const
+{
+	return FMath::Max(1,(Resolution>>Mip)/TileSize);
+}
+
+float UTrueSkyCoverageMapAsset::GetTexelSize(int32 Mip) const
+{
+	return WorldSize/(float)FMath::Max(1,Resolution>>Mip);
+}
+
+bool UTrueSkyCoverageMapAsset::GetTile(int32 Mip,int32 TileX,int32 TileY,TArray<uint8> &OutTexels)
+{
+	FScopeLock Lock(&TilesCriticalSection);
+	if(Mip<0||Mip>=MipFirstTiles.Num())
+		return false;
+	int32 Side=GetTilesPerSide(Mip);
+	if(TileX<0||TileY<0||TileX>=Side||TileY>=Side)
+		return false;
+	int32 Index=MipFirstTiles[Mip]+TileY*Side+TileX;
+	if(!Tiles.IsValidIndex(Index)||!FTrueSkyBulkData::Copy(Tiles[Index],BulkDataFilename,OutTexels))
+		return false;
+	return OutTexels.Num()==TileSize*TileSize*BytesPerTexel;
+}
+
+void UTrueSkyCoverageMapAsset::Serialize(FArchive& Ar)
+{
+	Super::Serialize(Ar);
+	Ar.UsingCustomVersion(FTrueSkyCoverageMapVersion::GUID);
+	FScopeLock Lock(&TilesCriticalSection);
+	if(Ar.IsLoading()&&Ar.CustomVer(FTrueSkyCoverageMapVersion::GUID)<FTrueSkyCoverageMapVersion::BulkDataTiles)
+	{
+		// No tiles follow, so the mips have none to read: PostLoad rebuilds them in the editor.
+		Tiles.Empty();
+		MipFirstTiles.Empty();
+		return;
+	}
+	int32 NumTiles=Tiles.Num();
+	Ar<<NumTiles;
+	if(Ar.IsLoading())
+	{
+		BulkDataFilename=FTrueSkyBulkData::GetPackageFilename(this,Ar);
+		Tiles.Empty(NumTiles);
+		for(int32 i=0;i<NumTiles;i++)
+			Tiles.Add(new FByteBulkData);
+	}
+	for(int32 i=0;i<NumTiles;i++)
+		Tiles[i].Serialize(Ar,this);
+}
+
+#if WITH_EDITOR
+void UTrueSkyCoverageMapAsset::PostLoad()
+{
+	Super::PostLoad();
+	// Maps saved before the tiles were bulk data have none, and Serialize has dropped their mips.
+	if(Tiles.Num()==0&&SourceTexture)
+	{
+		SourceTexture->ConditionalPostLoad();
+		Build();
+	}
+}
+
+void UTrueSkyCoverageMapAsset::Build()
+{
+	// A streamer may be reading tiles on a worker thread.
+	FScopeLock Lock(&TilesCriticalSection);
+	Tiles.Empty();
+	BulkDataFilename.Empty();
+	MipFirstTiles.Empty();
+	Resolution=0;
+	if(!SourceTexture)
+		return;
+	TileSize=FMath::RoundUpToPowerOfTwo(FMath::Clamp(TileSize,16,256));
+	TArray<uint8> Source;
+	if(SourceTexture->Source.GetFormat()!=TSF_BGRA8||!SourceTexture->Source.GetMipData(Source,0))
+	{
+		UE_LOG(TrueSkyCoverageMap,Warning,TEXT("%s: source texture %s must be BGRA8"),*GetName(),*SourceTexture->GetName());
+		return;
+	}
+	int32 SourceW=SourceTexture->Source.GetSizeX();
+	int32 SourceH=SourceTexture->Source.GetSizeY();
+	// Resample to a square power of two number of whole tiles.
+	Resolution=FMath::Max(TileSize,(int32)FMath::RoundUpToPowerOfTwo(FMath::Max(SourceW,SourceH)));
+	TArray<uint8> Level;
+	Level.SetNumUninitialized(Resolution*Resolution*BytesPerTexel);
+	for(int32 y=0;y<Resolution;y++)
+	{
+		const uint8 *Row=Source.GetData()+(y*SourceH/Resolution)*SourceW*4;
+		for(int32 x=0;x<Resolution;x++)
+		{
+			const uint8 *BGRA=Row+(x*SourceW/Resolution)*4;
+			Level[(y*Resolution+x)*BytesPerTexel+0]=BGRA[2];
+			Level[(y*Resolution+x)*BytesPerTexel+1]=BGRA[1];
+		}
+	}
+	for(int32 Size=Resolution;Size>=TileSize;Size/=2)
+	{
+		// Split the level into tiles.
+		MipFirstTiles.Add(Tiles.Num());
+		int32 Side=Size/TileSize;
+		TArray<uint8> Tile;
+		for(int32 ty=0;ty<Side;ty++)
+		{
+			for(int32 tx=0;tx<Side;tx++)
+			{
+				Tile.Empty(TileSize*TileSize*BytesPerTexel);
+				for(int32 y=0;y<TileSize;y++)
+				{
+					const uint8 *Row=Level.GetData()+((ty*TileSize+y)*Size+tx*TileSize)*BytesPerTexel;
+					Tile.Append(Row,TileSize*BytesPerTexel);
+				}
+				FTrueSkyBulkData::Store(Tiles[Tiles.Add(new FByteBulkData)],Tile);
+			}
+		}
+		// Box filter down to the next level.
+		int32 Half=Size/2;
+		TArray<uint8> Next;
+		Next.SetNumUninitialized(Half*Half*BytesPerTexel);
+		for(int32 y=0;y<Half;y++)
+		{
+			for(int32 x=0;x<Half;x++)
+			{
+				for(int32 c=0;c<BytesPerTexel;c++)
+				{
+					int32 Sum=Level[((2*y)*Size+2*x)*BytesPerTexel+c]+Level[((2*y)*Size+2*x+1)*BytesPerTexel+c]
+						+Level[((2*y+1)*Size+2*x)*BytesPerTexel+c]+Level[((2*y+1)*Size+2*x+1)*BytesPerTexel+c];
+					Next[(y*Half+x)*BytesPerTexel+c]=(uint8)((Sum+2)/4);
+				}
+			}
+		}
+		Level=Next;
+	}
+}
+
+void UTrueSkyCoverageMapAsset::PostEditChangeProperty(FPropertyChangedEvent& PropertyChangedEvent)
+{
+	Super::PostEditChangeProperty(PropertyChangedEvent);
+	FName PropertyName=PropertyChangedEvent.Property?PropertyChangedEvent.Property->GetFName():NAME_None;
+	if(PropertyName==TEXT("SourceTexture")||PropertyName==TEXT("TileSize"))
+		Build();
+}
+#endif
@@ -0,0 +1,263 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyCoverageMapStreamer.h"
+#include "TrueSkyCoverageMapAsset.h"
+
+const FIntPoint FTrueSkyCoverageMapStreamer::InvalidTile(MAX_int32,MAX_int32);
+
+/** Reads a batch of a coverage map's tiles on a worker thread, so the game thread never waits on the disk for them. */
+class FTrueSkyCoverageTileReadTask
+{
+	UTrueSkyCoverageMapAsset *Map;
+	int32 Mip;
+	TArray<FIntPoint> Tiles;
+	TArray< TArray<uint8> > &Texels;
+
+public:
+	FTrueSkyCoverageTileReadTask(UTrueSkyCoverageMapAsset *InMap,int32 InMip,const TArray<FIntPoint> &InTiles,TArray< TArray<uint8> > &OutTexels)
+		:Map(InMap)
+		,Mip(InMip)
+		,Tiles(InTiles)
+		,Texels(OutTexels)
+	{
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FTrueSkyCoverageTileReadTask, STATGROUP_TaskGraphTasks);
+	}
+
+	ENamedThreads::Type GetDesiredThread()
+	{
+		return ENamedThreads::AnyThread;
+	}
+
+	static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::TrackSubsequents; }
+
+	void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		Texels.Empty(Tiles.Num());
+		Texels.AddZeroed(Tiles.Num());
+		for(int32 i=0;i<Tiles.Num();i++)
+		{
+			if(!Map->GetTile(Mip,Tiles[i].X,Tiles[i].Y,Texels[i]))
+				Texels[i].Empty();
+		}
+	}
+};
+
+FTrueSkyCoverageMapStreamer::FTrueSkyCoverageMapStreamer()
+	:CurrentMap(NULL)
+	,Mip(0)
+	,SlotsPerSide(0)
+	,FillPending(false)
+	,FillCameraTile(0,0)
+	,ReadFill(false)
+	,ReadStale(false)
+{
+}
+
+FTrueSkyCoverageMapStreamer::~FTrueSkyCoverageMapStreamer()
+{
+	Reset();
+}
+
+void FTrueSkyCoverageMapStreamer::CancelRead()
+{
+	if(ReadTask.GetReference())
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(ReadTask);
+	ReadTask	=NULL;
+	ReadFill	=false;
+	ReadStale	=false;
+	ReadTiles.Empty();
+	ReadTexels.Empty();
+}
+
+void FTrueSkyCoverageMapStreamer::StartRead(UTrueSkyCoverageMapAsset *Map,const TArray<FIntPoint> &Tiles,int32 FromMip,bool Fill)
+{
+	ReadTiles	=Tiles;
+	ReadFill	=Fill;
+	ReadStale	=false;
+	ReadTexels.Empty();
+	ReadTask=TGraphTask<FTrueSkyCoverageTileReadTask>::CreateTask().ConstructAndDispatchWhenReady(Map,FromMip,Tiles,ReadTexels);
+}
+
+void FTrueSkyCoverageMapStreamer::Reset()
+{
+	CancelRead();
+	if(CurrentMap&&ITrueSkyPlugin::IsAvailable())
+		ITrueSkyPlugin::Get().UpdateCloudCoverageInput(0,0,FVector2D(0.0f,0.0f),0.0f,false,FIntRect(),NULL);
+	CurrentMap		=NULL;
+	SlotsPerSide	=0;
+	FillPending		=false;
+	Slots.Empty();
+}
+
+int32 FTrueSkyCoverageMapStreamer::GetResidentTileCount() const
+{
+	int32 Count=0;
+	for(int32 i=0;i<Slots.Num();i++)
+	{
+		if(Slots[i]!=InvalidTile)
+			Count++;
+	}
+	return Count;
+}
+
+static FORCEINLINE int32 PositiveModulo(int32 A,int32 B)
+{
+	int32 M=A%B;
+	return M<0?M+B:M;
+}
+
+void FTrueSkyCoverageMapStreamer::UploadTile(UTrueSkyCoverageMapAsset *Map,const FIntPoint &Tile,const TArray<uint8> &Source)
+{
+	int32 T				=Map->TileSize;
+	TArray<FFloat16Color> *Texels=new TArray<FFloat16Color>;
+	Texels->SetNumUninitialized(T*T);
+	if(Source.Num()==T*T*UTrueSkyCoverageMapAsset::BytesPerTexel)
+	{
+		for(int32 i=0;i<T*T;i++)
+			(*Texels)[i]=FFloat16Color(FLinearColor(Source[i*2]/255.0f,Source[i*2+1]/255.0f,0.0f,0.0f));
+	}
+	else
+	{
+		FFloat16Color Default(FLinearColor(Map->DefaultCoverage,Map->DefaultHumidity,0.0f,0.0f));
+		for(int32 i=0;i<T*T;i++)
+			(*Texels)[i]=Default;
+	}
+	int32 N		=SlotsPerSide;
+	int32 SlotX	=PositiveModulo(Tile.X,N);
+	int32 SlotY	=PositiveModulo(Tile.Y,N);
+	FVector2D Origin=Map->WorldOrigin;
+	ITrueSkyPlugin::Get().UpdateCloudCoverageInput(N*T,N*T,Origin,N*T*Map->GetTexelSize(Mip),true
+		,FIntRect(SlotX*T,SlotY*T,(SlotX+1)*T,(SlotY+1)*T),Texels);
+	Slots[SlotY*N+SlotX]=Tile;
+}
+
+void FTrueSkyCoverageMapStreamer::FillWindow(UTrueSkyCoverageMapAsset *Map,const FIntPoint &CameraTile,const TArray<uint8> &Coarse)
+{
+	int32 T				=Map->TileSize;
+	int32 N				=SlotsPerSide;
+	int32 Coarsest		=Map->GetNumMips()-1;
+	bool HaveCoarse		=Coarse.Num()==T*T*UTrueSkyCoverageMapAsset::BytesPerTexel;
+	float TexelSize		=Map->GetTexelSize(Mip);
+	float CoarseTexelSize=Map->GetTexelSize(Coarsest);
+	FFloat16Color Default(FLinearColor(Map->DefaultCoverage,Map->DefaultHumidity,0.0f,0.0f));
+	TArray<FFloat16Color> *Texels=new TArray<FFloat16Color>;
+	Texels->SetNumUninitialized(N*T*N*T);
+	int32 First=-(N/2);
+	for(int32 SlotY=0;SlotY<N;SlotY++)
+	{
+		// The tile of the window around the camera that this slot will hold.
+		int32 TileY=CameraTile.Y+First+PositiveModulo(SlotY-CameraTile.Y-First,N);
+		for(int32 SlotX=0;SlotX<N;SlotX++)
+		{
+			int32 TileX=CameraTile.X+First+PositiveModulo(SlotX-CameraTile.X-First,N);
+			for(int32 y=0;y<T;y++)
+			{
+				int32 CoarseY=FMath::FloorToInt((TileY*T+y+0.5f)*TexelSize/CoarseTexelSize);
+				FFloat16Color *Row=Texels->GetData()+(SlotY*T+y)*N*T+SlotX*T;
+				for(int32 x=0;x<T;x++)
+				{
+					int32 CoarseX=FMath::FloorToInt((TileX*T+x+0.5f)*TexelSize/CoarseTexelSize);
+					if(HaveCoarse&&CoarseX>=0&&CoarseY>=0&&CoarseX<T&&CoarseY<T)
+					{
+						const uint8 *Source=Coarse.GetData()+(CoarseY*T+CoarseX)*UTrueSkyCoverageMapAsset::BytesPerTexel;
+						Row[x]=FFloat16Color(FLinearColor(Source[0]/255.0f,Source[1]/255.0f,0.0f,0.0f));
+					}
+					else
+					{
+						Row[x]=Default;
+					}
+				}
+			}
+		}
+	}
+	ITrueSkyPlugin::Get().UpdateCloudCoverageInput(N*T,N*T,Map->WorldOrigin,N*T*TexelSize,true,FIntRect(0,0,N*T,N*T),Texels);
+}
+
+void FTrueSkyCoverageMapStreamer::Update(UTrueSkyCoverageMapAsset *Map,const FVector &Camera,float Range,int32 ResidentTiles,int32 MaxUploads)
+{
+	if(!Map||Map->GetNumMips()==0||!ITrueSkyPlugin::IsAvailable())
+	{
+		Reset();
+		return;
+	}
+	int32 N=FMath::Max(2,(int32)FMath::Sqrt((float)ResidentTiles));
+	// The finest mip whose window, less the partly covered tile, spans the range either side of the camera.
+	int32 NewMip=0;
+	while(NewMip+1<Map->GetNumMips()&&(N-1)*Map->TileSize*Map->GetTexelSize(NewMip)<2.0f*Range)
+		NewMip++;
+	float TileWorldSize=Map->TileSize*Map->GetTexelSize(NewMip);
+	int32 CameraTileX=FMath::FloorToInt((Camera.X-Map->WorldOrigin.X)/TileWorldSize);
+	int32 CameraTileY=FMath::FloorToInt((Camera.Y-Map->WorldOrigin.Y)/TileWorldSize);
+	// The old map may not outlive this frame, so its read is waited for rather than left to finish.
+	if(Map!=CurrentMap)
+		CancelRead();
+	if(Map!=CurrentMap||NewMip!=Mip||N!=SlotsPerSide)
+	{
+		CurrentMap		=Map;
+		Mip				=NewMip;
+		SlotsPerSide	=N;
+		Slots.Init(InvalidTile,N*N);
+		FillPending		=true;
+		ReadStale		=ReadTask.GetReference()!=NULL;
+	}
+	if(ReadTask.GetReference())
+	{
+		if(!ReadTask->IsComplete())
+			return;
+		ReadTask=NULL;
+		// A read for a window that has since changed is dropped.
+		if(!ReadStale)
+		{
+			if(ReadFill)
+			{
+				// The input is rescaled to the new mip at once; its slots would otherwise show the old mip's tiles out of place.
+				// Until now it has kept the old mip's tiles at the old mip's scale, which are still in place.
+				FillWindow(Map,FillCameraTile,ReadTexels[0]);
+			}
+			else
+			{
+				for(int32 i=0;i<ReadTiles.Num();i++)
+					UploadTile(Map,ReadTiles[i],ReadTexels[i]);
+			}
+		}
+		ReadTiles.Empty();
+		ReadTexels.Empty();
+		ReadStale=false;
+	}
+	if(FillPending)
+	{
+		FillPending		=false;
+		FillCameraTile	=FIntPoint(CameraTileX,CameraTileY);
+		TArray<FIntPoint> Coarsest;
+		Coarsest.Add(FIntPoint(0,0));
+		StartRead(Map,Coarsest,Map->GetNumMips()-1,true);
+		return;
+	}
+	int32 First=-(N/2);
+	// Rings outward from the camera's tile, so the nearest missing tiles go first.
+	TArray<FIntPoint> Missing;
+	for(int32 Ring=0;Ring<=N/2&&Missing.Num()<MaxUploads;Ring++)
+	{
+		for(int32 dy=-Ring;dy<=Ring&&Missing.Num()<MaxUploads;dy++)
+		{
+			for(int32 dx=-Ring;dx<=Ring&&Missing.Num()<MaxUploads;dx++)
+			{
+				if(FMath::Max(FMath::Abs(dx),FMath::Abs(dy))!=Ring)
+					continue;
+				if(dx<First||dy<First||dx>=First+N||dy>=First+N)
+					continue;
+				FIntPoint Tile(CameraTileX+dx,CameraTileY+dy);
+				if(Slots[PositiveModulo(Tile.Y,N)*N+PositiveModulo(Tile.X,N)]==Tile)
+					continue;
+				Missing.Add(Tile);
+			}
+		}
+	}
+	if(Missing.Num()>0)
+		StartRead(Map,Missing,Mip,false);
+}
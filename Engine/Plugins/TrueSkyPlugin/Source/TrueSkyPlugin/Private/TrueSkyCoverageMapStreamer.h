@@ -0,0 +1,64 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+#include "TaskGraphInterfaces.h"
+
+class UTrueSkyCoverageMapAsset;
+
+/**
+ * Keeps a square window of a coverage map's tiles around the camera resident in trueSKY's
+ * cloud coverage input. The input is addressed toroidally, tile (x,y) living in slot
+ * (x mod N,y mod N), so as the camera moves only the tiles entering the window are uploaded,
+ * nearest first, a few per frame. The tiles are read from the package on a worker thread, a batch
+ * at a time, and uploaded on the frame after the read completes.
+ */
+class FTrueSkyCoverageMapStreamer
+{
+public:
+	FTrueSkyCoverageMapStreamer();
+	~FTrueSkyCoverageMapStreamer();
+
+	/**
+	 * Call once per frame from the game thread. Range is the distance around the camera that should be
+	 * covered, ResidentTiles the budget of tiles in the input, and MaxUploads the most tiles to upload.
+	 */
+	void			Update(UTrueSkyCoverageMapAsset *Map,const FVector &Camera,float Range,int32 ResidentTiles,int32 MaxUploads);
+	/** Waits for any read in flight, removes the input, and forgets what was resident. */
+	void			Reset();
+
+	int32			GetMip() const
+	{
+		return Mip;
+	}
+	int32			GetResidentTileCount() const;
+
+protected:
+	/** Copies a tile's texels, as read by GetTile, into the coverage input's slot for it; if there are none, the default coverage. */
+	void			UploadTile(UTrueSkyCoverageMapAsset *Map,const FIntPoint &Tile,const TArray<uint8> &Source);
+	/**
+	 * Fills the whole window around CameraTile from the coarsest mip, a single tile, so that the slots
+	 * hold something near right until their own tiles come in, rather than another mip's tiles.
+	 */
+	void			FillWindow(UTrueSkyCoverageMapAsset *Map,const FIntPoint &CameraTile,const TArray<uint8> &Coarse);
+	/** Starts reading Tiles of FromMip on a worker thread. Fill marks the read of the coarsest tile, for FillWindow. */
+	void			StartRead(UTrueSkyCoverageMapAsset *Map,const TArray<FIntPoint> &Tiles,int32 FromMip,bool Fill);
+	/** Waits for any read in flight, and drops what it read. */
+	void			CancelRead();
+
+	const UTrueSkyCoverageMapAsset *CurrentMap;
+	int32			Mip;
+	int32			SlotsPerSide;
+	/** The tile held by each slot, or InvalidTile. */
+	TArray<FIntPoint> Slots;
+	/** Set when the window changes, until the read of the coarsest tile to fill it has been started. */
+	bool			FillPending;
+	FIntPoint		FillCameraTile;
+	/** The read in flight, and the tiles it is for; once complete, ReadTexels holds them, empty where there are none. */
+	FGraphEventRef	ReadTask;
+	TArray<FIntPoint> ReadTiles;
+	TArray< TArray<uint8> > ReadTexels;
+	bool			ReadFill;
+	/** Set when the window has changed under the read in flight, whose tiles are then dropped. */
+	bool			ReadStale;
+	static const FIntPoint InvalidTile;
+};
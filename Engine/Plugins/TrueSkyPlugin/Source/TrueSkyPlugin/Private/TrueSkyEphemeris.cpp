@@ -0,0 +1,95 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyEphemeris.h"
+
+static const double DegToRad=PI/180.0;
+static const double RadToDeg=180.0/PI;
+/** Julian date of J2000.0 */
+static const double J2000=2451545.0;
+
+// FMath's trigonometry is single precision; the CRT's is used throughout, since the angles here
+// grow by ~360 degrees a day and float loses arc-minutes on them.
+static FORCEINLINE double WrapDegrees(double a)
+{
+	return a-360.0*floor(a/360.0);
+}
+
+/** Equatorial (right ascension, declination) to horizontal (azimuth from north, elevation), all in radians. */
+static FORCEINLINE void EquatorialToHorizontal(double RA,double Dec,double LocalSiderealTime,double SinLat,double CosLat,float &OutAzimuth,float &OutElevation)
+{
+	double H		=LocalSiderealTime-RA;
+	double SinDec	=sin(Dec),CosDec=cos(Dec);
+	double CosH		=cos(H);
+	double SinEl	=SinLat*SinDec+CosLat*CosDec*CosH;
+	double Az		=atan2(-CosDec*sin(H),SinDec*CosLat-CosDec*CosH*SinLat);
+	OutElevation	=(float)(asin(FMath::Clamp(SinEl,-1.0,1.0))*RadToDeg);
+	OutAzimuth		=(float)WrapDegrees(Az*RadToDeg);
+}
+
+void FTrueSkyEphemeris::Compute(int32 Count,const double *JulianDates,double Latitude,double Longitude
+		,float *OutSunAzimuth,float *OutSunElevation
+		,float *OutMoonAzimuth,float *OutMoonElevation
+		,float *OutMoonIllumination,float *OutMoonPhase)
+{
+	const double SinLat=sin(Latitude*DegToRad);
+	const double CosLat=cos(Latitude*DegToRad);
+	for(int32 i=0;i<Count;i++)
+	{
+		double d		=JulianDates[i]-J2000;
+		double Obliquity=(23.439-0.0000004*d)*DegToRad;
+		double SinObl	=sin(Obliquity),CosObl=cos(Obliquity);
+		double LST		=WrapDegrees(280.46061837+360.98564736629*d+Longitude)*DegToRad;
+
+		// Sun: ecliptic longitude from mean longitude and mean anomaly; latitude is ~0.
+		double g		=WrapDegrees(357.529+0.98560028*d)*DegToRad;
+		double q		=WrapDegrees(280.459+0.98564736*d);
+		double SunLon	=(q+1.915*sin(g)+0.020*sin(2.0*g))*DegToRad;
+		double SunRA	=atan2(CosObl*sin(SunLon),cos(SunLon));
+		double SunDec	=asin(SinObl*sin(SunLon));
+
+		// Moon: the largest periodic terms (equation of centre, evection, variation, annual equation).
+		double L		=WrapDegrees(218.316+13.176396*d);
+		double M		=WrapDegrees(134.963+13.064993*d)*DegToRad;
+		double F		=WrapDegrees(93.272+13.229350*d)*DegToRad;
+		double D		=WrapDegrees(297.850+12.190749*d)*DegToRad;
+		double MoonLon	=(L+6.289*sin(M)+1.274*sin(2.0*D-M)+0.658*sin(2.0*D)+0.214*sin(2.0*M)-0.186*sin(g)-0.114*sin(2.0*F))*DegToRad;
+		double MoonLat	=(5.128*sin(F)+0.281*sin(M+F)+0.278*sin(M-F)+0.173*sin(2.0*D-F))*DegToRad;
+		double SinMoonLat=sin(MoonLat),CosMoonLat=cos(MoonLat);
+		double MoonRA	=atan2(sin(MoonLon)*CosObl-SinMoonLat/CosMoonLat*SinObl,cos(MoonLon));
+		double MoonDec	=asin(SinMoonLat*CosObl+CosMoonLat*SinObl*sin(MoonLon));
+
+		float SunAz,SunEl,MoonAz,MoonEl;
+		EquatorialToHorizontal(SunRA,SunDec,LST,SinLat,CosLat,SunAz,SunEl);
+		EquatorialToHorizontal(MoonRA,MoonDec,LST,SinLat,CosLat,MoonAz,MoonEl);
+		// Topocentric parallax: the moon is close enough to sit up to a degree lower seen from the surface than from the centre.
+		double MoonParallax=(0.9508+0.0518*cos(M))*DegToRad;
+		MoonEl-=(float)(asin(sin(MoonParallax)*cos(MoonEl*DegToRad))*RadToDeg);
+
+		// Phase from the elongation of the moon from the sun.
+		double Elongation=WrapDegrees((MoonLon-SunLon)*RadToDeg);
+		if(OutSunAzimuth)
+			OutSunAzimuth[i]=SunAz;
+		if(OutSunElevation)
+			OutSunElevation[i]=SunEl;
+		if(OutMoonAzimuth)
+			OutMoonAzimuth[i]=MoonAz;
+		if(OutMoonElevation)
+			OutMoonElevation[i]=MoonEl;
+		if(OutMoonIllumination)
+			OutMoonIllumination[i]=(float)(0.5*(1.0-cos(Elongation*DegToRad)));
+		if(OutMoonPhase)
+			OutMoonPhase[i]=(float)(Elongation/360.0);
+	}
+}
+
+FTrueSkyEphemerisResult FTrueSkyEphemeris::Compute(double Latitude,double Longitude,const FDateTime &UTCTime)
+{
+	FTrueSkyEphemerisResult Result;
+	double JulianDate=GetJulianDate(UTCTime);
+	Compute(1,&JulianDate,Latitude,Longitude
+		,&Result.SunAzimuth,&Result.SunElevation
+		,&Result.MoonAzimuth,&Result.MoonElevation
+		,&Result.MoonIllumination,&Result.MoonPhase);
+	return Result;
+}
@@ -0,0 +1,173 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyKeyframeStreamer.h"
+#include "TrueSkySequenceAsset.h"
+#include "TrueSkySequenceKeyframes.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyKeyframes, Log, All);
+
+/** Merges a window of keyframe blocks into the coarse sequence on a worker thread. */
+class FTrueSkyKeyframeMergeTask
+{
+	TArray<uint8> Coarse;
+	TArray< TArray<uint8> > Blocks;
+	float StartDay,EndDay;
+	TArray<uint8> &Text;
+	bool &Failed;
+
+public:
+	FTrueSkyKeyframeMergeTask(const TArray<uint8> &InCoarse,const TArray< TArray<uint8> > &InBlocks,float InStartDay,float InEndDay,TArray<uint8> &OutText,bool &OutFailed)
+		:Coarse(InCoarse)
+		,Blocks(InBlocks)
+		,StartDay(InStartDay)
+		,EndDay(InEndDay)
+		,Text(OutText)
+		,Failed(OutFailed)
+	{
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FTrueSkyKeyframeMergeTask, STATGROUP_TaskGraphTasks);
+	}
+
+	ENamedThreads::Type GetDesiredThread()
+	{
+		return ENamedThreads::AnyThread;
+	}
+
+	static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::TrackSubsequents; }
+
+	void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		Failed=!FTrueSkySequenceKeyframes::Merge(Coarse,Blocks,StartDay,EndDay,Text);
+	}
+};
+
+FTrueSkyKeyframeStreamer::FTrueSkyKeyframeStreamer()
+	:CurrentSequence(NULL)
+	,Window(INDEX_NONE)
+	,LastBlock(INDEX_NONE)
+	,Direction(1)
+	,MergeWindow(INDEX_NONE)
+	,MergeFailed(false)
+	,WantedWindow(INDEX_NONE)
+	,FailedWindow(INDEX_NONE)
+{
+}
+
+FTrueSkyKeyframeStreamer::~FTrueSkyKeyframeStreamer()
+{
+	Reset();
+}
+
+void FTrueSkyKeyframeStreamer::Reset()
+{
+	if(MergeTask.GetReference())
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(MergeTask);
+	MergeTask		=NULL;
+	CurrentSequence	=NULL;
+	Window			=INDEX_NONE;
+	LastBlock		=INDEX_NONE;
+	Direction		=1;
+	MergeWindow		=INDEX_NONE;
+	MergeFailed		=false;
+	WantedWindow	=INDEX_NONE;
+	FailedWindow	=INDEX_NONE;
+	MergedText.Empty();
+}
+
+int32 FTrueSkyKeyframeStreamer::GetWindowStart(int32 Block,int32 WindowBlocks,int32 NumBlocks) const
+{
+	// One block behind, to interpolate back across the boundary; the rest ahead.
+	int32 First=Direction>=0?Block-1:Block+2-WindowBlocks;
+	return FMath::Clamp(First,0,NumBlocks-WindowBlocks);
+}
+
+void FTrueSkyKeyframeStreamer::StartMerge(int32 First,int32 WindowBlocks)
+{
+	// The blocks are small, so they're read here; the parsing and merging is the expensive part.
+	TArray<uint8> Coarse;
+	TArray< TArray<uint8> > Blocks;
+	Blocks.AddZeroed(WindowBlocks);
+	bool Loaded=CurrentSequence->GetSequenceText(Coarse);
+	for(int32 i=0;i<WindowBlocks&&Loaded;i++)
+		Loaded=CurrentSequence->GetKeyframeBlock(First+i,Blocks[i]);
+	MergeWindow=First;
+	MergedText.Empty();
+	if(!Loaded)
+	{
+		MergeFailed=true;
+		return;
+	}
+	float BlockDays=CurrentSequence->KeyframeBlockDays;
+	MergeTask=TGraphTask<FTrueSkyKeyframeMergeTask>::CreateTask().ConstructAndDispatchWhenReady(Coarse,Blocks
+		,First*BlockDays,(First+WindowBlocks)*BlockDays,MergedText,MergeFailed);
+}
+
+bool FTrueSkyKeyframeStreamer::Update(UTrueSkySequenceAsset *Sequence,float Time,int32 WindowBlocks,int32 &OutWindow,TArray<uint8> &OutText)
+{
+	if(Sequence!=CurrentSequence||!Sequence||Sequence->GetNumKeyframeBlocks()==0)
+	{
+		bool Changed=Window!=INDEX_NONE;
+		Reset();
+		CurrentSequence=Sequence;
+		OutWindow=INDEX_NONE;
+		OutText.Empty();
+		return Changed;
+	}
+	if(MergeTask.GetReference())
+	{
+		if(!MergeTask->IsComplete())
+			return false;
+		MergeTask=NULL;
+	}
+	if(MergeFailed)
+	{
+		// Stay with the coarse keyframes for this window rather than retrying every frame.
+		UE_LOG(TrueSkyKeyframes, Warning, TEXT("%s: failed to load keyframe blocks from %d"), *Sequence->GetName(), MergeWindow);
+		FailedWindow	=MergeWindow;
+		MergeWindow		=INDEX_NONE;
+		MergeFailed		=false;
+		MergedText.Empty();
+		return false;
+	}
+	int32 NumBlocks	=Sequence->GetNumKeyframeBlocks();
+	WindowBlocks	=FMath::Clamp(WindowBlocks,2,NumBlocks);
+	int32 Block		=FMath::Clamp((int32)(FMath::Max(Time,0.0f)/Sequence->KeyframeBlockDays),0,NumBlocks-1);
+	if(LastBlock!=INDEX_NONE&&Block!=LastBlock)
+		Direction=Block>LastBlock?1:-1;
+	LastBlock=Block;
+	int32 Wanted=GetWindowStart(Block,WindowBlocks,NumBlocks);
+	if(Wanted!=WantedWindow)
+	{
+		WantedWindow	=Wanted;
+		FailedWindow	=INDEX_NONE;
+	}
+	bool Changed=false;
+	if(Wanted!=Window)
+	{
+		if(MergeWindow==Wanted&&MergedText.Num()>0)
+		{
+			Window		=Wanted;
+			OutWindow	=Window;
+			Exchange(OutText,MergedText);
+			MergedText.Empty();
+			MergeWindow	=INDEX_NONE;
+			Changed		=true;
+		}
+		else
+		{
+			// E.g. time has jumped: the keyframes outside the current window are coarse, and do until this is in.
+			if(Wanted!=FailedWindow)
+				StartMerge(Wanted,WindowBlocks);
+			return false;
+		}
+	}
+	// Prefetch the window that will be wanted when time reaches the next block.
+	int32 Next=GetWindowStart(FMath::Clamp(Block+Direction,0,NumBlocks-1),WindowBlocks,NumBlocks);
+	if(Next!=Window&&Next!=MergeWindow&&Next!=FailedWindow)
+		StartMerge(Next,WindowBlocks);
+	return Changed;
+}
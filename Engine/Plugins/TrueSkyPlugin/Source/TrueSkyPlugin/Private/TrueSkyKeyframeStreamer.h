@@ -0,0 +1,49 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+#include "TaskGraphInterfaces.h"
+
+class UTrueSkySequenceAsset;
+
+/**
+ * Keeps a window of a cooked sequence's keyframe blocks around the current time resident, for
+ * sequences cooked with StreamKeyframes. Windows are merged into the coarse sequence on a worker
+ * thread, and the next window in the direction time is moving is merged ahead of need. Until a
+ * window is ready, e.g. after a jump in time, the coarse keyframes outside the current window stand in.
+ */
+class FTrueSkyKeyframeStreamer
+{
+public:
+	FTrueSkyKeyframeStreamer();
+	~FTrueSkyKeyframeStreamer();
+
+	/**
+	 * Call once per frame from the game thread, with the time in days. WindowBlocks is how many blocks to keep
+	 * resident. Returns true when the window to render with has changed: OutWindow is its first block, or
+	 * INDEX_NONE for the whole sequence, and OutText its sequence text.
+	 */
+	bool			Update(UTrueSkySequenceAsset *Sequence,float Time,int32 WindowBlocks,int32 &OutWindow,TArray<uint8> &OutText);
+	/** Waits for any merge in flight, and forgets the sequence. */
+	void			Reset();
+
+protected:
+	/** First block of the window of WindowBlocks around Block, biased in the direction time is moving. */
+	int32			GetWindowStart(int32 Block,int32 WindowBlocks,int32 NumBlocks) const;
+	/** Starts merging the window from First on a worker thread. */
+	void			StartMerge(int32 First,int32 WindowBlocks);
+
+	UTrueSkySequenceAsset *CurrentSequence;
+	/** First block of the window in use, or INDEX_NONE. */
+	int32			Window;
+	int32			LastBlock;
+	/** +1 while time goes forward, -1 backward. */
+	int32			Direction;
+	/** The merge in flight, and the window it is for; once complete, MergedText holds it. */
+	FGraphEventRef	MergeTask;
+	int32			MergeWindow;
+	TArray<uint8>	MergedText;
+	bool			MergeFailed;
+	/** The window wanted last frame, and the last window that failed to merge, which isn't retried until that changes. */
+	int32			WantedWindow;
+	int32			FailedWindow;
+};
@@ -26,6 +26,11 @@
 
 DEFINE_LOG_CATEGORY_STATIC(TrueSky, Log, All);
 
+DECLARE_STATS_GROUP(TEXT("TrueSky"),STATGROUP_TrueSky,STATCAT_Advanced);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Clear sky path"),STAT_TrueSkyClearPath,STATGROUP_TrueSky);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Night path"),STAT_TrueSkyNightPath,STATGROUP_TrueSky);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Overcast path"),STAT_TrueSkyOvercastPath,STATGROUP_TrueSky);
+
 #include "D3D11RHI.h"
 // Dependencies.
 #include "Core.h"
@@ -39,12 +44,34 @@ DECLARE_LOG_CATEGORY_EXTERN(LogD3D11RHI, Log, All);
 #include "../Private/Windows/D3D11RHIBasePrivate.h"
 #include "StaticArray.h"
 #include "ActorCrossThreadProperties.h"
+#include "SkyCrossThreadSnapshot.h"
+#include "TrueSkySequencePipeline.h"
+#include "Engine/StreamableManager.h"
 
 
+/** The registered UTrueSkyComponent's settings. Render thread only. */
 ActorCrossThreadProperties actorCrossThreadProperties;
-extern ActorCrossThreadProperties *GetActorCrossThreadProperties()
+
+/** Cloud extinction per km at full density, as in the CPU renderer. */
+static const float CloudExtinctionPerKm=40.0f;
+
+/** The render thread's working copy. Render thread only: the game thread sees it through PublishSkyCrossThreadSnapshot. */
+SkyCrossThreadSnapshot skyCrossThreadSnapshot;
+/** The last copy published to the game thread, and the lock that guards it. */
+static SkyCrossThreadSnapshot publishedSkyCrossThreadSnapshot;
+static FCriticalSection skyCrossThreadSnapshotSection;
+
+/** Copies the render thread's working snapshot to the game thread's side, whole, so no reader sees it half-written. */
+static void PublishSkyCrossThreadSnapshot()
+{
+	FScopeLock Lock(&skyCrossThreadSnapshotSection);
+	publishedSkyCrossThreadSnapshot=skyCrossThreadSnapshot;
+}
+
+extern SkyCrossThreadSnapshot GetSkyCrossThreadSnapshot()
 {
-	return &actorCrossThreadProperties;
+	FScopeLock Lock(&skyCrossThreadSnapshotSection);
+	return publishedSkyCrossThreadSnapshot;
 }
 
 /** This is a macro that casts a dynamically bound RHI reference to the appropriate D3D type. */
@@ -210,7 +237,18 @@ public:
 
 	/** If there is a TrueSkySequenceActor in the persistent level, this returns that actor's TrueSkySequenceAsset */
 	UTrueSkySequenceAsset*	GetActiveSequence();
+	bool					SetSequenceForEvaluation(UTrueSkySequenceAsset* Sequence) override;
+	void					PrefetchSequence(UTrueSkySequenceAsset* Sequence) override;
+	void					StreamSequence(const FStringAssetReference &Sequence) override;
+	void					ReleaseSequence(const FStringAssetReference &Sequence) override;
+	void					ForgetSequence(UTrueSkySequenceAsset* Sequence) override;
+	void					OnSequenceStreamed(FStringAssetReference Sequence);
+	void					UpdateCloudCoverageInput(int32 Width,int32 Height,const FVector2D &Origin,float Size,bool Wrap,const FIntRect &Region,TArray<FFloat16Color> *Texels) override;
 	void UpdateFromActor();
+	/** Takes over the settings and sequence text of a component's proxy; NULL when it unregisters. Render thread. */
+	void					SetRenderProxy(FTrueSkyRenderProxy *Proxy);
+	/** Frees the textures made for rendering, which are remade when next needed. Render thread. */
+	void					ReleaseRenderResources();
 	
 #if INCLUDE_UE_EDITOR_FEATURES
 	struct SEditorInstance
@@ -268,6 +306,47 @@ public:
 protected:
 	
 	void					RenderCloudShadow();
+	/** Returns the reduced-resolution cloud depth target for the view, (re)creating it on size change. */
+	FTexture2DRHIRef		GetCloudDepthTexture(int view_id,int w,int h);
+	/** Copies this frame's sun/moon visibility to a staging texture, and publishes the oldest one that is ready. */
+	void					ReadBackSunVisibility(ID3D11Device *device,ID3D11DeviceContext *context);
+	void					ReleaseSunVisibility();
+	/** Hands the actor's cloud shadow target, where the actor placed it, to the dll to render. */
+	void					UpdateCloudShadow();
+	/** Cloud density (0-1) at a world position, from the dll if it can tell us, else estimated from the layer's extent and coverage. */
+	float					GetCloudDensityAt(const FVector &Position);
+	/** Switches the dll to its cheaper inside-cloud path, blended, while the camera is in cloud. */
+	void					UpdateInsideCloud(const FVector &ViewOrigin);
+	/** Above the cloud layer, has the dll render distant cloud tops from a heightfield it bakes from the volume. */
+	void					UpdateAboveCloud(const FVector &ViewOrigin);
+	/** Chooses 2D or volumetric rendering for the cloud layer, and paces the per-layer updates. */
+	void					UpdateCloudLayers();
+	/** Works out how far can be seen through the fog and cloud at the camera. */
+	void					UpdateVisibilityDistance(const FVector &ViewOrigin);
+	/** Picks the clear, night and overcast fast paths from the sky's current values. */
+	void					UpdateSkyPaths(const FVector &ViewOrigin);
+	/** Has the dll rebuild its cloud occupancy volume when the cloud density has changed. */
+	void					UpdateCloudOccupancy();
+	/**
+	 * Whether the dll knows a render float or bool. It can't list the names it knows, so a name counts as known if it
+	 * reads back a value written to it; the old value is put back. Probed once per name, and if unknown, logged
+	 * once as turning Feature off. Render thread.
+	 */
+	bool					SupportsRenderFloat(const char *name,const TCHAR *Feature);
+	bool					SupportsRenderBool(const char *name,const TCHAR *Feature);
+	/** Hands the sun, moon and cloud shadow values to the renderer for the view uniform buffers. */
+	void					PublishSkyRenderState();
+	struct FCloudCoverageInputUpdate
+	{
+		int32					Width,Height;
+		FVector2D				Origin;
+		float					Size;
+		bool					Wrap;
+		FIntRect				Region;
+		TArray<FFloat16Color>	*Texels;
+	};
+	/** Render thread side of UpdateCloudCoverageInput. */
+	void					ApplyCloudCoverageInput(const FCloudCoverageInputUpdate &Update);
 	void					OnMainWindowClosed(const TSharedRef<SWindow>& Window);
 
 	/** Called when Toggle rendering button is pressed */
@@ -361,6 +440,11 @@ protected:
 	typedef void (*FStaticSetKeyframeInt)(unsigned,const char *name, int value);
 	typedef int (*FStaticGetKeyframeInt)(unsigned,const char *name);
 
+	// Optional exports: older render dll's don't have these, so they may be NULL.
+	typedef void (*FStaticSetRenderTexture)( const char *name,void *texture );
+	typedef void (*FStaticSetPreparedSequence)( void *prepared );
+	typedef float (*FStaticGetRenderFloatAtPosition)( const char *name,const float *pos );
+
 	FOpenUI								OpenUI;
 	FCloseUI							CloseUI;
 	FStaticSetUIString					StaticSetUIString;
@@ -394,6 +478,10 @@ protected:
 	FStaticSetKeyframeInt				StaticSetKeyframeInt;
 	FStaticGetKeyframeInt				StaticGetKeyframeInt;
 
+	FStaticSetRenderTexture				StaticSetRenderTexture;
+	FStaticSetPreparedSequence			StaticSetPreparedSequence;
+	FStaticGetRenderFloatAtPosition		StaticGetRenderFloatAtPosition;
+
 	TCHAR*					PathEnv;
 
 	bool					RenderingEnabled;
@@ -403,10 +491,84 @@ protected:
 	float					AutoSaveTimer;		// 0.0f == no auto-saving
 	
 	FRenderTarget			*cloudShadowRenderTarget;
+	TMap<int,FTexture2DRHIRef>	cloudDepthTextures;
+
+	/** 2x1 texel target the dll reduces the sun (x) and moon (y) disk transmittance into. */
+	FTexture2DRHIRef		sunVisibilityTexture;
+	/** Ring of staging copies, so the CPU never waits on the GPU to read them. */
+	static const int		NUM_SUN_VISIBILITY_STAGING=3;
+	ID3D11Texture2D			*sunVisibilityStaging[NUM_SUN_VISIBILITY_STAGING];
+	bool					sunVisibilityPending[NUM_SUN_VISIBILITY_STAGING];
+	uint32					sunVisibilityFrame;
+	uint32					sunVisibilityRenderFrame;
+
+	uint32					precipitationMapUpdate;
+	uint32					skyRenderStateFrame;
+
+	/** Cloud transmittance towards the sun, top-down around the camera: the actor's target, for a light function. */
+	FTexture2DRHIRef		cloudShadowTexture;
+	FVector2D				cloudShadowOrigin;
+	float					cloudShadowSize;
+	uint32					cloudShadowFrame;
+
+	/** 0 outside cloud, 1 fully in inside-cloud mode. */
+	float					insideCloudBlend;
+	double					insideCloudTime;
+	uint32					insideCloudFrame;
+
+	/** Cloud top height and density, top-down around the camera, for above-cloud mode. */
+	FTexture2DRHIRef		cloudTopTexture;
+	FVector2D				cloudTopOrigin;
+	FVector2D				cloudTopCloudOffset;
+	bool					aboveCloud;
+	float					aboveCloudBlend;
+	uint32					aboveCloudFrame;
+
+	bool					cloudLayer2D;
+	float					cloudLayer2DBlend;
+	double					cloudLayersTime;
+	double					cloudUpdateTime;
+	double					cloud2DUpdateTime;
+	/** UpdateClouds in bit 0 and Update2DClouds in bit 1, as last given to the dll; -1 before the first time. */
+	int32					cloudUpdateFlags;
+	uint32					cloudLayersFrame;
+
+	uint32					visibilityDistanceFrame;
+	bool					clearSkyPath;
+	bool					nightPath;
+	bool					overcastPath;
+	uint32					skyPathsFrame;
+	/** Whether the adaptive paths are in charge of the values below, and what they were before, to restore. */
+	bool					skyPathsActive;
+	bool					savedRenderClouds;
+	bool					savedRenderAtmosphereAboveClouds;
+	float					savedSkySampleScale;
+	float					savedSkyResolutionScale;
+
+	/** What SupportsRenderFloat and SupportsRenderBool found of each name, for the dll loaded. */
+	TMap<FString,bool>		renderValueSupport;
+
+	/** Checksum of the values the cloud density is generated from, as of the last occupancy rebuild. */
+	uint32					cloudOccupancyKey;
+	bool					cloudOccupancyDirty;
+
+	/** Coverage, humidity and wind over the area around the camera, from forecast data or a coverage map. */
+	FTexture2DRHIRef		cloudCoverageInputTexture;
+	FVector2D				cloudCoverageInputOrigin;
+	float					cloudCoverageInputSize;
+	bool					cloudCoverageInputWrap;
 
 	bool					actorPropertiesChanged;
 	bool					haveEditor;
 	UTrueSkySequenceAsset *sequenceInUse;
+	/** The keyframe window of sequenceInUse the dll has, or INDEX_NONE. */
+	int32					sequenceWindowInUse;
+	/** The text of actorCrossThreadProperties.activeSequence, copied on the game thread. */
+	TArray<uint8>			sequenceText;
+	/** Converts and parses upcoming sequences (e.g. the next weather state) off the game and render threads. */
+	FTrueSkySequencePipeline sequencePipeline;
+	/** Holds the sequences loaded by StreamSequence. */
+	FStreamableManager		sequenceStreamer;
 	
 #if INCLUDE_UE_EDITOR_FEATURES
 	TArray<SEditorInstance>	EditorInstances;
@@ -430,7 +592,50 @@ FTrueSkyPlugin::FTrueSkyPlugin()
 	:cloudShadowRenderTarget(NULL)
 	,actorPropertiesChanged(true)
 	,sequenceInUse(NULL)
+	,sequenceWindowInUse(INDEX_NONE)
+	,sunVisibilityFrame(0)
+	,sunVisibilityRenderFrame(0)
+	,precipitationMapUpdate(0)
+	,skyRenderStateFrame(0)
+	,cloudShadowOrigin(0.0f,0.0f)
+	,cloudShadowSize(0.0f)
+	,cloudShadowFrame(0)
+	,insideCloudBlend(0.0f)
+	,insideCloudTime(0.0)
+	,insideCloudFrame(0)
+	,cloudTopOrigin(0.0f,0.0f)
+	,cloudTopCloudOffset(0.0f,0.0f)
+	,aboveCloud(false)
+	,aboveCloudBlend(0.0f)
+	,aboveCloudFrame(0)
+	,cloudLayer2D(false)
+	,cloudLayer2DBlend(0.0f)
+	,cloudLayersTime(0.0)
+	,cloudUpdateTime(0.0)
+	,cloud2DUpdateTime(0.0)
+	,cloudUpdateFlags(-1)
+	,cloudLayersFrame(0)
+	,visibilityDistanceFrame(0)
+	,clearSkyPath(false)
+	,nightPath(false)
+	,overcastPath(false)
+	,skyPathsFrame(0)
+	,skyPathsActive(false)
+	,savedRenderClouds(true)
+	,savedRenderAtmosphereAboveClouds(true)
+	,savedSkySampleScale(1.0f)
+	,savedSkyResolutionScale(1.0f)
+	,cloudOccupancyKey(0)
+	,cloudOccupancyDirty(true)
+	,cloudCoverageInputOrigin(0.0f,0.0f)
+	,cloudCoverageInputSize(0.0f)
+	,cloudCoverageInputWrap(false)
 {
+	for(int i=0;i<NUM_SUN_VISIBILITY_STAGING;i++)
+	{
+		sunVisibilityStaging[i]=NULL;
+		sunVisibilityPending[i]=false;
+	}
 	Instance = this;
 #ifdef SHARED_FROM_THIS
 	//TSharedRef<FTrueSkyPlugin> sharedRef=AsShared();
@@ -482,6 +687,509 @@ void FTrueSkyPlugin::SetCloudShadowRenderTarget(FRenderTarget *t)
 	cloudShadowRenderTarget=t;
 }
 
+FTexture2DRHIRef FTrueSkyPlugin::GetCloudDepthTexture(int view_id,int w,int h)
+{
+	int downscale	=FMath::Max(1,actorCrossThreadProperties.CloudDepthDownscale);
+	int dw			=FMath::Max(1,w/downscale);
+	int dh			=FMath::Max(1,h/downscale);
+	FTexture2DRHIRef &tex=cloudDepthTextures.FindOrAdd(view_id);
+	if(!tex.IsValid()||tex->GetSizeX()!=dw||tex->GetSizeY()!=dh)
+	{
+		FRHIResourceCreateInfo CreateInfo;
+		tex=RHICreateTexture2D(dw,dh,PF_R32_FLOAT,1,1,TexCreate_RenderTargetable|TexCreate_ShaderResource,CreateInfo);
+	}
+	return tex;
+}
+
+void FTrueSkyPlugin::ReadBackSunVisibility(ID3D11Device *device,ID3D11DeviceContext *context)
+{
+	if(!sunVisibilityTexture.IsValid())
+		return;
+	// Once per frame, not per view.
+	if(sunVisibilityRenderFrame==GFrameNumberRenderThread)
+		return;
+	sunVisibilityRenderFrame=GFrameNumberRenderThread;
+	// Oldest first, so a newer value is never overwritten by a stale one: slot sunVisibilityFrame was copied
+	// a full ring ago (if still pending after a stall), and the slots after it are successively newer.
+	for(int i=0;i<NUM_SUN_VISIBILITY_STAGING;i++)
+	{
+		int idx=(sunVisibilityFrame+i)%NUM_SUN_VISIBILITY_STAGING;
+		if(!sunVisibilityPending[idx])
+			continue;
+		D3D11_MAPPED_SUBRESOURCE mapped;
+		HRESULT hr=context->Map(sunVisibilityStaging[idx],0,D3D11_MAP_READ,D3D11_MAP_FLAG_DO_NOT_WAIT,&mapped);
+		if(hr==DXGI_ERROR_WAS_STILL_DRAWING)
+			break;
+		if(SUCCEEDED(hr))
+		{
+			const float *vis=(const float*)mapped.pData;
+			skyCrossThreadSnapshot.SunVisibility	=FMath::Clamp(vis[0],0.0f,1.0f);
+			skyCrossThreadSnapshot.MoonVisibility	=FMath::Clamp(vis[1],0.0f,1.0f);
+			skyCrossThreadSnapshot.VisibilityFrame	=GFrameNumberRenderThread;
+			context->Unmap(sunVisibilityStaging[idx],0);
+			PublishSkyCrossThreadSnapshot();
+		}
+		sunVisibilityPending[idx]=false;
+	}
+	int idx=sunVisibilityFrame%NUM_SUN_VISIBILITY_STAGING;
+	// Still in flight after a full ring: skip this frame's copy rather than stall.
+	if(!sunVisibilityPending[idx])
+	{
+		if(!sunVisibilityStaging[idx])
+		{
+			D3D11_TEXTURE2D_DESC desc;
+			memset(&desc,0,sizeof(desc));
+			desc.Width				=2;
+			desc.Height				=1;
+			desc.MipLevels			=1;
+			desc.ArraySize			=1;
+			desc.Format				=DXGI_FORMAT_R32_FLOAT;
+			desc.SampleDesc.Count	=1;
+			desc.Usage				=D3D11_USAGE_STAGING;
+			desc.CPUAccessFlags		=D3D11_CPU_ACCESS_READ;
+			device->CreateTexture2D(&desc,NULL,&sunVisibilityStaging[idx]);
+		}
+		if(sunVisibilityStaging[idx])
+		{
+			FD3D11TextureBase *visTex=static_cast<FD3D11Texture2D*>(sunVisibilityTexture.GetReference());
+			context->CopyResource(sunVisibilityStaging[idx],visTex->GetResource());
+			sunVisibilityPending[idx]=true;
+			// Only a copy issued moves the ring on, so a skipped frame leaves the oldest pending slot first in line.
+			sunVisibilityFrame++;
+		}
+	}
+}
+
+void FTrueSkyPlugin::ReleaseSunVisibility()
+{
+	for(int i=0;i<NUM_SUN_VISIBILITY_STAGING;i++)
+	{
+		if(sunVisibilityStaging[i])
+			sunVisibilityStaging[i]->Release();
+		sunVisibilityStaging[i]=NULL;
+		sunVisibilityPending[i]=false;
+	}
+	sunVisibilityTexture.SafeRelease();
+}
+
+void FTrueSkyPlugin::UpdateCloudCoverageInput(int32 Width,int32 Height,const FVector2D &Origin,float Size,bool Wrap,const FIntRect &Region,TArray<FFloat16Color> *Texels)
+{
+	FCloudCoverageInputUpdate Update;
+	Update.Width	=Width;
+	Update.Height	=Height;
+	Update.Origin	=Origin;
+	Update.Size		=Size;
+	Update.Wrap		=Wrap;
+	Update.Region	=Region;
+	Update.Texels	=Texels;
+	ENQUEUE_UNIQUE_RENDER_COMMAND_TWOPARAMETER(
+		FUpdateTrueSkyCloudCoverageInput,
+		FTrueSkyPlugin*,Plugin,this,
+		FCloudCoverageInputUpdate,Update,Update,
+	{
+		Plugin->ApplyCloudCoverageInput(Update);
+	});
+}
+
+void FTrueSkyPlugin::ApplyCloudCoverageInput(const FCloudCoverageInputUpdate &Update)
+{
+	if(Update.Width<=0||Update.Height<=0)
+	{
+		cloudCoverageInputTexture.SafeRelease();
+		delete Update.Texels;
+		return;
+	}
+	if(!cloudCoverageInputTexture.IsValid()||cloudCoverageInputTexture->GetSizeX()!=Update.Width||cloudCoverageInputTexture->GetSizeY()!=Update.Height)
+	{
+		FRHIResourceCreateInfo CreateInfo;
+		cloudCoverageInputTexture=RHICreateTexture2D(Update.Width,Update.Height,PF_FloatRGBA,1,1,TexCreate_ShaderResource,CreateInfo);
+	}
+	if(Update.Texels&&Update.Texels->Num()>=Update.Region.Area())
+	{
+		FUpdateTextureRegion2D Region(Update.Region.Min.X,Update.Region.Min.Y,0,0,Update.Region.Width(),Update.Region.Height());
+		RHIUpdateTexture2D(cloudCoverageInputTexture,0,Region,Region.Width*sizeof(FFloat16Color),(const uint8*)Update.Texels->GetData());
+	}
+	delete Update.Texels;
+	cloudCoverageInputOrigin	=Update.Origin;
+	cloudCoverageInputSize		=Update.Size;
+	cloudCoverageInputWrap		=Update.Wrap;
+	cloudOccupancyDirty			=true;
+}
+
+void FTrueSkyPlugin::UpdateCloudShadow()
+{
+	// Once per frame, not per view.
+	if(cloudShadowFrame==GFrameNumberRenderThread)
+		return;
+	cloudShadowFrame=GFrameNumberRenderThread;
+	// Only rendered for something that samples it: the actor's target, for a light function on the sun.
+	FTextureRenderTargetResource *target=actorCrossThreadProperties.CloudShadowTarget;
+	if(actorCrossThreadProperties.SimpleCloudShadowing<=0.0f||actorCrossThreadProperties.CloudShadowRange<=0.0f||!target)
+	{
+		cloudShadowTexture.SafeRelease();
+		cloudShadowSize=0.0f;
+		StaticSetRenderTexture("CloudShadow",NULL);
+		return;
+	}
+	cloudShadowSize		=2.0f*actorCrossThreadProperties.CloudShadowRange;
+	cloudShadowTexture	=target->GetRenderTargetTexture();
+	// The actor places it, snapped to texels, to match the transform it gives the light function.
+	cloudShadowOrigin	=actorCrossThreadProperties.CloudShadowOrigin;
+	SetRenderFloat("CloudShadowOriginX",cloudShadowOrigin.X*0.01f);
+	SetRenderFloat("CloudShadowOriginY",cloudShadowOrigin.Y*0.01f);
+	SetRenderFloat("CloudShadowSize",cloudShadowSize*0.01f);
+	FD3D11TextureBase *shadowTex=static_cast<FD3D11Texture2D*>(cloudShadowTexture.GetReference());
+	StaticSetRenderTexture("CloudShadow",shadowTex->GetResource());
+}
+
+float FTrueSkyPlugin::GetCloudDensityAt(const FVector &Position)
+{
+	// trueSKY works in metres, Unreal in centimetres.
+	if(StaticGetRenderFloatAtPosition)
+	{
+		float pos[]={Position.X*0.01f,Position.Y*0.01f,Position.Z*0.01f};
+		return StaticGetRenderFloatAtPosition("CloudDensity",pos);
+	}
+	static const TCHAR *Feature=TEXT("the cloud density estimate at the camera");
+	if(!SupportsRenderFloat("CloudBaseKm",Feature)||!SupportsRenderFloat("CloudHeightKm",Feature)
+		||!SupportsRenderFloat("CloudCoverage",Feature)||!SupportsRenderFloat("CloudDensity",Feature))
+		return 0.0f;
+	float altitudeKm	=Position.Z*0.00001f;
+	float baseKm		=GetRenderFloat("CloudBaseKm");
+	float heightKm		=GetRenderFloat("CloudHeightKm");
+	if(altitudeKm<baseKm||altitudeKm>baseKm+heightKm)
+		return 0.0f;
+	return GetRenderFloat("CloudCoverage")*GetRenderFloat("CloudDensity");
+}
+
+void FTrueSkyPlugin::UpdateInsideCloud(const FVector &ViewOrigin)
+{
+	if(insideCloudFrame==GFrameNumberRenderThread)
+		return;
+	insideCloudFrame=GFrameNumberRenderThread;
+	static const TCHAR *Feature=TEXT("inside-cloud mode");
+	if(!SupportsRenderFloat("InsideCloudBlend",Feature)||!SupportsRenderFloat("InsideCloudFogDensity",Feature)
+		||!SupportsRenderFloat("InsideCloudMaxDistanceKm",Feature)||!SupportsRenderFloat("InsideCloudLightingStepScale",Feature))
+		return;
+	double now		=FPlatformTime::Seconds();
+	float dt		=insideCloudTime>0.0?(float)FMath::Min(now-insideCloudTime,0.25):0.0f;
+	insideCloudTime	=now;
+	float density	=actorCrossThreadProperties.InsideCloudMode?GetCloudDensityAt(ViewOrigin):0.0f;
+	float target	=density>actorCrossThreadProperties.InsideCloudThreshold?1.0f:0.0f;
+	float blendTime	=actorCrossThreadProperties.InsideCloudBlendTime;
+	if(blendTime>0.0f)
+		insideCloudBlend=target>insideCloudBlend?FMath::Min(target,insideCloudBlend+dt/blendTime):FMath::Max(target,insideCloudBlend-dt/blendTime);
+	else
+		insideCloudBlend=target;
+	// The dll fades in a local fog of the density at the camera, marches no further than a few times the
+	// visibility through it, and lights with fewer steps - all scaled by the blend.
+	SetRenderFloat("InsideCloudBlend",insideCloudBlend);
+	if(insideCloudBlend>0.0f)
+	{
+		float visibilityKm=3.0f/FMath::Max(0.01f,density*CloudExtinctionPerKm);
+		SetRenderFloat("InsideCloudFogDensity",density);
+		SetRenderFloat("InsideCloudMaxDistanceKm",FMath::Clamp(4.0f*visibilityKm,0.5f,50.0f));
+		SetRenderFloat("InsideCloudLightingStepScale",FMath::Lerp(1.0f,0.5f,insideCloudBlend));
+	}
+}
+
+void FTrueSkyPlugin::UpdateAboveCloud(const FVector &ViewOrigin)
+{
+	if(aboveCloudFrame==GFrameNumberRenderThread)
+		return;
+	aboveCloudFrame=GFrameNumberRenderThread;
+	const ActorCrossThreadProperties &A=actorCrossThreadProperties;
+	// Off and faded out: nothing to tell the dll.
+	if(!A.AboveCloudMode&&aboveCloudBlend<=0.0f&&!cloudTopTexture.IsValid())
+		return;
+	static const TCHAR *Feature=TEXT("above-cloud mode");
+	if(!StaticSetRenderTexture||!SupportsRenderFloat("CloudTopBlend",Feature)||!SupportsRenderFloat("CloudTopRaymarchDistanceKm",Feature)
+		||!SupportsRenderFloat("CloudTopOriginX",Feature)||!SupportsRenderFloat("CloudTopOriginY",Feature)||!SupportsRenderFloat("CloudTopSize",Feature)
+		||!SupportsRenderFloat("CloudBaseKm",Feature)||!SupportsRenderFloat("CloudHeightKm",Feature)
+		||!SupportsRenderFloat("CloudOffsetXKm",Feature)||!SupportsRenderFloat("CloudOffsetYKm",Feature))
+	{
+		aboveCloud		=false;
+		aboveCloudBlend	=0.0f;
+		cloudTopTexture.SafeRelease();
+		return;
+	}
+	// Enter above the margin, leave below half of it, so hovering near the threshold doesn't flip modes.
+	float topCm		=(GetRenderFloat("CloudBaseKm")+GetRenderFloat("CloudHeightKm"))*100000.0f;
+	float height	=ViewOrigin.Z-topCm;
+	if(!A.AboveCloudMode)
+		aboveCloud=false;
+	else if(aboveCloud)
+		aboveCloud=height>0.5f*A.AboveCloudMargin;
+	else
+		aboveCloud=height>A.AboveCloudMargin;
+	// Crossfade from raymarched to heightfield over about a second.
+	static const float BlendPerFrame=1.0f/60.0f;
+	aboveCloudBlend=aboveCloud?FMath::Min(1.0f,aboveCloudBlend+BlendPerFrame):FMath::Max(0.0f,aboveCloudBlend-BlendPerFrame);
+	SetRenderFloat("CloudTopBlend",aboveCloudBlend);
+	if(aboveCloudBlend<=0.0f)
+	{
+		if(cloudTopTexture.IsValid())
+			StaticSetRenderTexture("CloudTopHeightfield",NULL);
+		cloudTopTexture.SafeRelease();
+		return;
+	}
+	static const int32 CloudTopResolution=512;
+	bool regenerate=false;
+	if(!cloudTopTexture.IsValid())
+	{
+		FRHIResourceCreateInfo CreateInfo;
+		cloudTopTexture=RHICreateTexture2D(CloudTopResolution,CloudTopResolution,PF_G16R16F,1,1,TexCreate_RenderTargetable|TexCreate_ShaderResource,CreateInfo);
+		regenerate=true;
+	}
+	// Rebake when the camera has moved an eighth of the way across, or the wind has moved the clouds a texel.
+	float size		=A.AboveCloudHeightfieldRange;
+	float step		=size/8.0f;
+	FVector2D origin(FMath::FloorToFloat(ViewOrigin.X/step)*step-0.5f*size,FMath::FloorToFloat(ViewOrigin.Y/step)*step-0.5f*size);
+	FVector2D cloudOffset=100000.0f*FVector2D(GetRenderFloat("CloudOffsetXKm"),GetRenderFloat("CloudOffsetYKm"));
+	regenerate|=origin!=cloudTopOrigin;
+	regenerate|=FVector2D::Distance(cloudOffset,cloudTopCloudOffset)>size/(float)CloudTopResolution;
+	SetRenderFloat("CloudTopRaymarchDistanceKm",A.AboveCloudRaymarchDistance*0.00001f);
+	if(regenerate)
+	{
+		cloudTopOrigin		=origin;
+		cloudTopCloudOffset	=cloudOffset;
+		SetRenderFloat("CloudTopOriginX",origin.X*0.01f);
+		SetRenderFloat("CloudTopOriginY",origin.Y*0.01f);
+		SetRenderFloat("CloudTopSize",size*0.01f);
+		FD3D11TextureBase *topTex=static_cast<FD3D11Texture2D*>(cloudTopTexture.GetReference());
+		StaticSetRenderTexture("CloudTopHeightfield",topTex->GetResource());
+		TriggerAction("UpdateCloudTopHeightfield");
+	}
+}
+
+void FTrueSkyPlugin::UpdateCloudLayers()
+{
+	if(cloudLayersFrame==GFrameNumberRenderThread)
+		return;
+	cloudLayersFrame=GFrameNumberRenderThread;
+	const ActorCrossThreadProperties &A=actorCrossThreadProperties;
+	double now		=FPlatformTime::Seconds();
+	float dt		=cloudLayersTime>0.0?(float)FMath::Min(now-cloudLayersTime,0.25):0.0f;
+	cloudLayersTime	=now;
+	// While the fast path is on or fading out, and only if the dll has it.
+	static const TCHAR *Feature=TEXT("the 2D cloud layer fast path");
+	bool fastPath	=(A.CloudLayerFastPath||cloudLayer2DBlend>0.0f)
+						&&SupportsRenderFloat("CloudLayer2DBlend",Feature)&&SupportsRenderFloat("CloudLayer2DAltitudeKm",Feature)
+						&&SupportsRenderFloat("CloudBaseKm",Feature)&&SupportsRenderFloat("CloudHeightKm",Feature)
+						&&SupportsRenderFloat("CloudDensity",Feature)&&SupportsRenderFloat("CloudCoverage",Feature);
+	if(fastPath)
+	{
+		// High or thin layers go 2D; the density test has some hysteresis so a layer fading out doesn't flicker between paths.
+		float baseCm	=GetRenderFloat("CloudBaseKm")*100000.0f;
+		float density	=GetRenderFloat("CloudDensity")*GetRenderFloat("CloudCoverage");
+		float threshold	=cloudLayer2D?1.25f*A.CloudLayerFastPathDensity:A.CloudLayerFastPathDensity;
+		cloudLayer2D	=A.CloudLayerFastPath&&(baseCm>A.CloudLayerFastPathAltitude||density<threshold);
+		static const float BlendTime=1.0f;
+		cloudLayer2DBlend=cloudLayer2D?FMath::Min(1.0f,cloudLayer2DBlend+dt/BlendTime):FMath::Max(0.0f,cloudLayer2DBlend-dt/BlendTime);
+		// The dll draws the volume's coverage and lighting on a plane at the middle of the layer, offset per pixel
+		// by the layer thickness for parallax, and skips the raymarch once the blend reaches one.
+		SetRenderFloat("CloudLayer2DBlend",cloudLayer2DBlend);
+		if(cloudLayer2DBlend>0.0f)
+			SetRenderFloat("CloudLayer2DAltitudeKm",GetRenderFloat("CloudBaseKm")+0.5f*GetRenderFloat("CloudHeightKm"));
+	}
+	else
+	{
+		cloudLayer2D		=false;
+		cloudLayer2DBlend	=0.0f;
+	}
+	// Slow, high layers needn't be relit every frame; without the switches for it, every layer updates every frame.
+	static const TCHAR *PacingFeature=TEXT("cloud update pacing");
+	if(!SupportsRenderBool("UpdateClouds",PacingFeature)||!SupportsRenderBool("Update2DClouds",PacingFeature))
+		return;
+	bool update3D	=now-cloudUpdateTime>=A.CloudUpdateInterval;
+	bool update2D	=now-cloud2DUpdateTime>=A.Cloud2DUpdateInterval;
+	if(update3D)
+		cloudUpdateTime=now;
+	if(update2D)
+		cloud2DUpdateTime=now;
+	// Usually both stay on, every frame; the dll only needs telling when that changes.
+	int32 flags		=(update3D?1:0)|(update2D?2:0);
+	if(flags!=cloudUpdateFlags)
+	{
+		cloudUpdateFlags=flags;
+		SetRenderBool("UpdateClouds",update3D);
+		SetRenderBool("Update2DClouds",update2D);
+	}
+}
+
+void FTrueSkyPlugin::UpdateVisibilityDistance(const FVector &ViewOrigin)
+{
+	if(visibilityDistanceFrame==GFrameNumberRenderThread)
+		return;
+	visibilityDistanceFrame=GFrameNumberRenderThread;
+	// Extinction per km at the camera: the haze falls off with altitude as in the sky model, the cloud with its density.
+	static const float HazeExtinctionPerKm=0.021f*1.1f;
+	static const float HazeScaleHeightKm=1.2f;
+	if(!SupportsRenderFloat("Haze",TEXT("visibility culling")))
+	{
+		skyCrossThreadSnapshot.VisibilityDistance=0.0f;
+		PublishSkyCrossThreadSnapshot();
+		return;
+	}
+	float altitudeKm	=FMath::Max(0.0f,ViewOrigin.Z*0.00001f);
+	float haze			=GetRenderFloat("Haze")*HazeExtinctionPerKm*FMath::Exp(-altitudeKm/HazeScaleHeightKm);
+	float cloud			=GetCloudDensityAt(ViewOrigin)*CloudExtinctionPerKm;
+	float extinction	=haze+cloud;
+	// Koschmieder: 2% contrast at 3.9 optical depths. Beyond 100 km the limit isn't worth culling to.
+	float visibilityKm	=extinction>0.0f?3.912f/extinction:0.0f;
+	skyCrossThreadSnapshot.VisibilityDistance=visibilityKm>0.0f&&visibilityKm<100.0f?visibilityKm*100000.0f:0.0f;
+	PublishSkyCrossThreadSnapshot();
+}
+
+void FTrueSkyPlugin::UpdateSkyPaths(const FVector &ViewOrigin)
+{
+	if(skyPathsFrame==GFrameNumberRenderThread)
+		return;
+	skyPathsFrame=GFrameNumberRenderThread;
+	if(!actorCrossThreadProperties.AdaptiveSkyPaths)
+	{
+		// Once, on switching off: hand the values back as they were.
+		if(skyPathsActive)
+		{
+			skyPathsActive=false;
+			clearSkyPath=nightPath=overcastPath=false;
+			SetRenderBool("RenderClouds",savedRenderClouds);
+			SetRenderBool("RenderAtmosphereAboveClouds",savedRenderAtmosphereAboveClouds);
+			SetRenderFloat("SkySampleScale",savedSkySampleScale);
+			SetRenderFloat("SkyResolutionScale",savedSkyResolutionScale);
+			SET_DWORD_STAT(STAT_TrueSkyClearPath,0);
+			SET_DWORD_STAT(STAT_TrueSkyNightPath,0);
+			SET_DWORD_STAT(STAT_TrueSkyOvercastPath,0);
+		}
+		return;
+	}
+	static const TCHAR *Feature=TEXT("adaptive sky paths");
+	if(!SupportsRenderBool("RenderClouds",Feature)||!SupportsRenderBool("RenderAtmosphereAboveClouds",Feature)
+		||!SupportsRenderFloat("SkySampleScale",Feature)||!SupportsRenderFloat("SkyResolutionScale",Feature)
+		||!SupportsRenderFloat("CloudCoverage",Feature)||!SupportsRenderFloat("CloudDensity",Feature)
+		||!SupportsRenderFloat("SunElevationDegrees",Feature)||!SupportsRenderFloat("CloudBaseKm",Feature))
+		return;
+	// Each test leaves its path at a different value than it enters it, so the paths don't flicker at the threshold.
+	float cover		=GetRenderFloat("CloudCoverage")*GetRenderFloat("CloudDensity");
+	float elevation	=GetRenderFloat("SunElevationDegrees");
+	float baseCm	=GetRenderFloat("CloudBaseKm")*100000.0f;
+	bool clear		=cover<(clearSkyPath?0.02f:0.01f);
+	bool night		=elevation<(nightPath?-6.0f:-8.0f);
+	bool overcast	=GetRenderFloat("CloudCoverage")>(overcastPath?0.93f:0.97f)&&ViewOrigin.Z<baseCm;
+	if(skyPathsActive&&clear==clearSkyPath&&night==nightPath&&overcast==overcastPath)
+		return;
+	if(!skyPathsActive)
+	{
+		skyPathsActive						=true;
+		savedRenderClouds					=GetRenderBool("RenderClouds");
+		savedRenderAtmosphereAboveClouds	=GetRenderBool("RenderAtmosphereAboveClouds");
+		savedSkySampleScale					=GetRenderFloat("SkySampleScale");
+		savedSkyResolutionScale				=GetRenderFloat("SkyResolutionScale");
+	}
+	UE_LOG(TrueSky,Verbose,TEXT("Sky paths: clear %d, night %d, overcast %d"),clear,night,overcast);
+	clearSkyPath	=clear;
+	nightPath		=night;
+	overcastPath	=overcast;
+	// These only change what the dll draws each frame; nothing is reinitialized.
+	SetRenderBool("RenderClouds",!clearSkyPath);
+	SetRenderBool("RenderAtmosphereAboveClouds",!overcastPath);
+	SetRenderFloat("SkySampleScale",nightPath?0.5f:1.0f);
+	SetRenderFloat("SkyResolutionScale",nightPath?0.5f:1.0f);
+	SET_DWORD_STAT(STAT_TrueSkyClearPath,clearSkyPath?1:0);
+	SET_DWORD_STAT(STAT_TrueSkyNightPath,nightPath?1:0);
+	SET_DWORD_STAT(STAT_TrueSkyOvercastPath,overcastPath?1:0);
+}
+
+bool FTrueSkyPlugin::SupportsRenderFloat(const char *name,const TCHAR *Feature)
+{
+	FString key=FString(TEXT("float "))+ANSI_TO_TCHAR(name);
+	const bool *found=renderValueSupport.Find(key);
+	if(found)
+		return *found;
+	bool known=false;
+	if(StaticGetRenderFloat&&StaticSetRenderFloat)
+	{
+		// A probe value most of the dll's ranges allow, and unlike the value there already.
+		float old	=StaticGetRenderFloat(name);
+		float probe	=FMath::Abs(old-0.25f)>0.1f?0.25f:0.75f;
+		StaticSetRenderFloat(name,probe);
+		known		=FMath::Abs(StaticGetRenderFloat(name)-probe)<1e-4f;
+		StaticSetRenderFloat(name,old);
+	}
+	if(!known)
+		UE_LOG(TrueSky,Warning,TEXT("The trueSKY runtime doesn't know the render float %s, so %s is off"),ANSI_TO_TCHAR(name),Feature);
+	renderValueSupport.Add(key,known);
+	return known;
+}
+
+bool FTrueSkyPlugin::SupportsRenderBool(const char *name,const TCHAR *Feature)
+{
+	FString key=FString(TEXT("bool "))+ANSI_TO_TCHAR(name);
+	const bool *found=renderValueSupport.Find(key);
+	if(found)
+		return *found;
+	bool known=false;
+	if(StaticGetRenderBool&&StaticSetRenderBool)
+	{
+		bool old	=StaticGetRenderBool(name);
+		StaticSetRenderBool(name,!old);
+		known		=StaticGetRenderBool(name)!=old;
+		StaticSetRenderBool(name,old);
+	}
+	if(!known)
+		UE_LOG(TrueSky,Warning,TEXT("The trueSKY runtime doesn't know the render bool %s, so %s is off"),ANSI_TO_TCHAR(name),Feature);
+	renderValueSupport.Add(key,known);
+	return known;
+}
+
+void FTrueSkyPlugin::UpdateCloudOccupancy()
+{
+	// RebuildCloudOccupancy can't be probed itself; a runtime with the volume knows the switch for it.
+	if(!SupportsRenderBool("CloudOccupancySkipping",TEXT("empty-space skipping")))
+		return;
+	bool enabled=actorCrossThreadProperties.EmptySpaceSkipping;
+	SetRenderBool("CloudOccupancySkipping",enabled);
+	// Once the 2D layer has fully taken over, nothing is raymarched, so there is nothing to skip; the blend
+	// itself doesn't change the density, so a layer part way between the paths needn't rebuild every frame.
+	if(!enabled||cloudLayer2DBlend>=1.0f)
+	{
+		cloudOccupancyDirty=true;
+		return;
+	}
+	// The wind only moves the clouds, so the offset isn't part of the key - the dll's volume is in cloud space.
+	float values[]={GetRenderFloat("CloudCoverage"),GetRenderFloat("CloudDensity"),GetRenderFloat("CloudBaseKm")
+					,GetRenderFloat("CloudHeightKm"),GetRenderFloat("CloudScaleKm")};
+	uint32 key=FCrc::MemCrc32(values,sizeof(values));
+	if(key==cloudOccupancyKey&&!cloudOccupancyDirty)
+		return;
+	cloudOccupancyKey	=key;
+	cloudOccupancyDirty	=false;
+	TriggerAction("RebuildCloudOccupancy");
+}
+
+void FTrueSkyPlugin::PublishSkyRenderState()
+{
+	// Once per frame, not per view. The views of the next frame pick it up.
+	if(skyRenderStateFrame==GFrameNumberRenderThread)
+		return;
+	skyRenderStateFrame=GFrameNumberRenderThread;
+	FSkyRenderState State;
+	// Towards the sun and moon, against the light; the actor pushes its ephemeris into the runtime, so this matches the sun light.
+	State.SunDirection	=-ATrueSkySequenceActor::GetRuntimeSunRotation(*this).Vector();
+	State.SunColor		=0.5f*FLinearColor(GetRenderFloat("SunIrradianceRed"),GetRenderFloat("SunIrradianceGreen"),GetRenderFloat("SunIrradianceBlue"));
+	State.MoonDirection	=-ATrueSkySequenceActor::GetRuntimeMoonRotation(*this).Vector();
+	float time			=GetRenderFloat("time");
+	State.TimeOfDay		=time-FMath::FloorToFloat(time);
+	State.SunVisibility	=skyCrossThreadSnapshot.SunVisibility;
+	State.CloudShadowStrength	=actorCrossThreadProperties.SimpleCloudShadowing;
+	State.CloudShadowSharpness	=actorCrossThreadProperties.SimpleCloudShadowSharpness;
+	State.CloudShadowTexture	=cloudShadowTexture;
+	State.CloudShadowOrigin		=cloudShadowOrigin;
+	State.CloudShadowSize		=cloudShadowSize;
+	State.VisibilityDistance	=actorCrossThreadProperties.CullToVisibility?skyCrossThreadSnapshot.VisibilityDistance:0.0f;
+	GetRendererModule().SetSkyRenderState(State);
+}
+
 void FTrueSkyPlugin::RenderCloudShadow()
 {
 	if(!cloudShadowRenderTarget)
@@ -826,6 +1534,11 @@ void FTrueSkyPlugin::StartupModule()
 	StaticSetKeyframeInt			=NULL;
 	StaticGetKeyframeInt			=NULL;
 
+	StaticSetRenderTexture			=NULL;
+	StaticSetPreparedSequence		=NULL;
+	StaticGetRenderFloatAtPosition	=NULL;
+	sequencePipeline.Startup();
+
 	PathEnv = NULL;
 #if INCLUDE_UE_EDITOR_FEATURES
 	MessageId = RegisterWindowMessage(L"RESIZE");
@@ -868,9 +1581,70 @@ void FTrueSkyPlugin::RenderFrame( FPostOpaqueRenderParameters& RenderParameters
 		v.h=RenderParameters.ViewportRect.Height();
 		unsigned uid=((unsigned)v.w<<(unsigned)24)+((unsigned)v.h<<(unsigned)16)+((unsigned)View->StereoPass);
         int view_id = StaticGetOrAddView((void*)uid);		// RVK: really need a unique view ident to pass here..
+		if(StaticSetRenderTexture)
+		{
+			// The dll writes the average transmittance depth of the clouds here; the renderer keeps
+			// it for depth of field, height fog and translucency sorting.
+			FD3D11TextureBase *cloudDepthTex=NULL;
+			if(actorCrossThreadProperties.CloudDepthOutput)
+			{
+				FTexture2DRHIRef tex=GetCloudDepthTexture(view_id,v.w,v.h);
+				RenderParameters.CloudDepthTexture=tex;
+				cloudDepthTex=static_cast<FD3D11Texture2D*>(RenderParameters.CloudDepthTexture);
+			}
+			else
+				cloudDepthTextures.Empty();
+			StaticSetRenderTexture("CloudDepth",cloudDepthTex?cloudDepthTex->GetResource():NULL);
+			if(!sunVisibilityTexture.IsValid())
+			{
+				FRHIResourceCreateInfo CreateInfo;
+				sunVisibilityTexture=RHICreateTexture2D(2,1,PF_R32_FLOAT,1,1,TexCreate_RenderTargetable|TexCreate_ShaderResource,CreateInfo);
+			}
+			FD3D11TextureBase *visTex=static_cast<FD3D11Texture2D*>(sunVisibilityTexture.GetReference());
+			StaticSetRenderTexture("SunVisibility",visTex->GetResource());
+			// The precipitation map only changes at the actor's update interval, not every frame.
+			FTextureRenderTargetResource *precipitationTarget=actorCrossThreadProperties.PrecipitationTarget;
+			if(precipitationTarget&&precipitationMapUpdate!=actorCrossThreadProperties.PrecipitationMapUpdate)
+			{
+				precipitationMapUpdate=actorCrossThreadProperties.PrecipitationMapUpdate;
+				FD3D11TextureBase *precipitationTex=static_cast<FD3D11Texture2D*>(precipitationTarget->GetRenderTargetTexture().GetReference());
+				// trueSKY works in metres, Unreal in centimetres.
+				SetRenderFloat("PrecipitationMapOriginX",actorCrossThreadProperties.PrecipitationMapOrigin.X*0.01f);
+				SetRenderFloat("PrecipitationMapOriginY",actorCrossThreadProperties.PrecipitationMapOrigin.Y*0.01f);
+				SetRenderFloat("PrecipitationMapSize",actorCrossThreadProperties.PrecipitationMapSize*0.01f);
+				StaticSetRenderTexture("PrecipitationMap",precipitationTex->GetResource());
+				TriggerAction("UpdatePrecipitationMap");
+			}
+			// Without a coverage input trueSKY falls back to the sequence's global coverage.
+			FD3D11TextureBase *coverageTex=static_cast<FD3D11Texture2D*>(cloudCoverageInputTexture.GetReference());
+			if(coverageTex)
+			{
+				SetRenderFloat("CloudCoverageInputOriginX",cloudCoverageInputOrigin.X*0.01f);
+				SetRenderFloat("CloudCoverageInputOriginY",cloudCoverageInputOrigin.Y*0.01f);
+				SetRenderFloat("CloudCoverageInputSize",cloudCoverageInputSize*0.01f);
+				SetRenderBool("CloudCoverageInputWrap",cloudCoverageInputWrap);
+			}
+			StaticSetRenderTexture("CloudCoverageInput",coverageTex?coverageTex->GetResource():NULL);
+			UpdateCloudShadow();
+		}
+		UpdateInsideCloud(View->ViewMatrices.ViewOrigin);
+		UpdateAboveCloud(View->ViewMatrices.ViewOrigin);
+		UpdateCloudLayers();
+		UpdateCloudOccupancy();
+		UpdateSkyPaths(View->ViewMatrices.ViewOrigin);
+		UpdateVisibilityDistance(View->ViewMatrices.ViewOrigin);
+		// Foveation: the periphery of each eye is raymarched at reduced resolution/sample count,
+		// and reconstructed with the same upsampler as half-resolution mode.
+		SetRenderFloat("FoveaCenterX",RenderParameters.FoveaCenter.X);
+		SetRenderFloat("FoveaCenterY",RenderParameters.FoveaCenter.Y);
+		SetRenderFloat("FoveaInnerRadius",RenderParameters.FoveaInnerRadius);
+		SetRenderFloat("FoveaOuterRadius",RenderParameters.FoveaOuterRadius);
+		SetRenderFloat("FoveaMinScale",RenderParameters.FoveaMinScale);
 		StaticRenderFrame( device,view_id, &(mirroredViewMatrix.M[0][0]), &(RenderParameters.ProjMatrix.M[0][0])
 			,(ID3D11Texture2D*)depthTex->GetResource(),depthTex->GetShaderResourceView(),&v
 							 ,UNREAL_STYLE);
+		ReadBackSunVisibility(device,context);
+		PublishSkyRenderState();
 		RenderCloudShadow();
 	}
 }
@@ -917,6 +1691,16 @@ void FTrueSkyPlugin::ShutdownModule()
 #endif
 	delete PathEnv;
 	PathEnv = NULL;
+	sequencePipeline.Shutdown();
+	ENQUEUE_UNIQUE_RENDER_COMMAND_ONEPARAMETER(
+		FReleaseTrueSkySunVisibility,
+		FTrueSkyPlugin*,Plugin,this,
+	{
+		Plugin->ReleaseSunVisibility();
+		Plugin->cloudCoverageInputTexture.SafeRelease();
+		Plugin->ReleaseRenderResources();
+	});
+	FlushRenderingCommands();
 }
 
 
@@ -1052,6 +1836,7 @@ bool FTrueSkyPlugin::InitRenderingInterface(  )
 	}
 	if ( DllHandle != NULL )
 	{
+		renderValueSupport.Empty();
 		StaticInitInterface				=(FStaticInitInterface)FPlatformProcess::GetDllExport(DllHandle, TEXT("StaticInitInterface") );
 		StaticPushPath					=(FStaticPushPath)FPlatformProcess::GetDllExport(DllHandle, TEXT("StaticPushPath") );
 		StaticGetOrAddView				=(FStaticGetOrAddView)FPlatformProcess::GetDllExport(DllHandle, TEXT("StaticGetOrAddView") );
@@ -1078,6 +1863,16 @@ bool FTrueSkyPlugin::InitRenderingInterface(  )
 		StaticSetKeyframeInt			=(FStaticSetKeyframeInt)FPlatformProcess::GetDllExport(DllHandle,	TEXT("StaticRenderKeyframeSetInt"));
 		StaticGetKeyframeInt			=(FStaticGetKeyframeInt)FPlatformProcess::GetDllExport(DllHandle,	TEXT("StaticRenderKeyframeGetInt"));
 
+		// Optional - not checked below.
+		StaticSetRenderTexture			=(FStaticSetRenderTexture)FPlatformProcess::GetDllExport(DllHandle,	TEXT("StaticSetRenderTexture"));
+		StaticSetPreparedSequence		=(FStaticSetPreparedSequence)FPlatformProcess::GetDllExport(DllHandle,	TEXT("StaticSetPreparedSequence"));
+		StaticGetRenderFloatAtPosition	=(FStaticGetRenderFloatAtPosition)FPlatformProcess::GetDllExport(DllHandle,TEXT("StaticGetRenderFloatAtPosition"));
+		FTrueSkySequencePipeline::FPrepareSequence PrepareSequence=(FTrueSkySequencePipeline::FPrepareSequence)FPlatformProcess::GetDllExport(DllHandle,TEXT("StaticPrepareSequence"));
+		FTrueSkySequencePipeline::FReleasePreparedSequence ReleasePreparedSequence=(FTrueSkySequencePipeline::FReleasePreparedSequence)FPlatformProcess::GetDllExport(DllHandle,TEXT("StaticReleasePreparedSequence"));
+		// A prepared sequence is only any use if we can hand it back and free it.
+		if(StaticSetPreparedSequence&&ReleasePreparedSequence)
+			sequencePipeline.SetPrepareFunctions(PrepareSequence,ReleasePreparedSequence);
+
 		if( StaticInitInterface == NULL ||StaticPushPath==NULL|| StaticRenderFrame == NULL || StaticGetOrAddView==NULL||
 			StaticOnDeviceChanged == NULL || StaticTick == NULL  || 
 			StaticGetEnvironment == NULL || StaticSetSequence == NULL||StaticGetRenderInterfaceInstance==NULL
@@ -1177,17 +1972,40 @@ void FTrueSkyPlugin::SequenceChanged()
 {
 	if(!RenderingEnabled)
 		return;
+	// The asset is only a key here; its text came with the component's proxy.
 	UTrueSkySequenceAsset* const ActiveSequence = GetActiveSequence();
 	if(ActiveSequence)
 	{
-		if(ActiveSequence->SequenceText.Num()>0)
+		void *Prepared=NULL;
+		std::string PreparedText;
+		// The pipeline holds the asset's own text, not a streamed window of its keyframes.
+		bool Windowed=actorCrossThreadProperties.SequenceWindow!=INDEX_NONE;
+		if(!Windowed&&sequencePipeline.TakePrepared(ActiveSequence,Prepared,PreparedText))
+		{
+			if(Prepared)
+				StaticSetPreparedSequence(Prepared);
+			else
+				StaticSetSequence(PreparedText);
+		}
+		else if(sequenceText.Num()>0)
 		{
 			std::string SequenceInputText;
-			SequenceInputText = std::string((const char*)ActiveSequence->SequenceText.GetData());
+			SequenceInputText = std::string((const char*)sequenceText.GetData());
 			StaticSetSequence(SequenceInputText);
 		}
+		else
+		{
+			// Freed after an earlier upload: ask the component for it, and try again when it comes.
+			skyCrossThreadSnapshot.SequenceTextNeeded=true;
+			PublishSkyCrossThreadSnapshot();
+			return;
+		}
+		// Cooked, nothing edits the sequence, so the dll's parsed copy is all that's needed.
+		if(FPlatformProperties::RequiresCookedData())
+			sequenceText.Empty();
 	}
 	sequenceInUse=ActiveSequence;
+	sequenceWindowInUse=actorCrossThreadProperties.SequenceWindow;
 }
 
 IMPLEMENT_TOGGLE(ShowFades)
@@ -1249,10 +2067,8 @@ bool FTrueSkyPlugin::IsAddSequenceEnabled()
 
 void FTrueSkyPlugin::UpdateFromActor()
 {
-	if(sequenceInUse!=GetActiveSequence())
+	if(sequenceInUse!=GetActiveSequence()||sequenceWindowInUse!=actorCrossThreadProperties.SequenceWindow)
 		SequenceChanged();
-	if(actorCrossThreadProperties.Destroyed)
-		actorCrossThreadProperties.Visible=false;
 	if(actorCrossThreadProperties.Visible!=RenderingEnabled)
 	{
 		OnToggleRendering();
@@ -1264,11 +2080,102 @@ void FTrueSkyPlugin::UpdateFromActor()
 	}
 }
 
+void SetTrueSkyRenderProxy(FTrueSkyRenderProxy *Proxy)
+{
+	check(IsInRenderingThread());
+	if(FTrueSkyPlugin::Instance)
+		FTrueSkyPlugin::Instance->SetRenderProxy(Proxy);
+	delete Proxy;
+}
+
+void FTrueSkyPlugin::SetRenderProxy(FTrueSkyRenderProxy *Proxy)
+{
+	if(!Proxy)
+	{
+		// Invisible, so the next frame switches rendering off - unless the component re-registers first.
+		actorCrossThreadProperties=ActorCrossThreadProperties();
+		sequenceText.Empty();
+		ReleaseRenderResources();
+		return;
+	}
+	if(Proxy->Properties.activeSequence!=actorCrossThreadProperties.activeSequence
+		||Proxy->Properties.SequenceWindow!=actorCrossThreadProperties.SequenceWindow||Proxy->SequenceText.Num()>0)
+	{
+		Exchange(sequenceText,Proxy->SequenceText);
+		skyCrossThreadSnapshot.SequenceTextNeeded=false;
+		PublishSkyCrossThreadSnapshot();
+	}
+	actorCrossThreadProperties=Proxy->Properties;
+}
+
+void FTrueSkyPlugin::ReleaseRenderResources()
+{
+	cloudShadowTexture.SafeRelease();
+	cloudShadowSize=0.0f;
+	cloudTopTexture.SafeRelease();
+	aboveCloudBlend=0.0f;
+	cloudDepthTextures.Empty();
+	GetRendererModule().SetSkyRenderState(FSkyRenderState());
+}
+
 UTrueSkySequenceAsset* FTrueSkyPlugin::GetActiveSequence()
 {
 	return actorCrossThreadProperties.activeSequence;
 }
 
+bool FTrueSkyPlugin::SetSequenceForEvaluation(UTrueSkySequenceAsset* Sequence)
+{
+	InitPaths();
+	if(!RendererInitialized&&!InitRenderingInterface())
+		return false;
+	TArray<uint8> SequenceText;
+	if(!Sequence||!Sequence->GetSequenceText(SequenceText))
+		return false;
+	std::string SequenceInputText=std::string((const char*)SequenceText.GetData());
+	StaticSetSequence(SequenceInputText);
+	return true;
+}
+
+void FTrueSkyPlugin::PrefetchSequence(UTrueSkySequenceAsset* Sequence)
+{
+	if(!Sequence||Sequence==sequenceInUse||sequencePipeline.IsPrefetched(Sequence))
+		return;
+	TArray<uint8> SequenceText;
+	if(Sequence->GetSequenceText(SequenceText))
+		sequencePipeline.Prefetch(Sequence,SequenceText);
+}
+
+void FTrueSkyPlugin::StreamSequence(const FStringAssetReference &Sequence)
+{
+	if(!Sequence.IsValid())
+		return;
+	sequenceStreamer.RequestAsyncLoad(Sequence,FStreamableDelegate::CreateRaw(this,&FTrueSkyPlugin::OnSequenceStreamed,Sequence));
+}
+
+void FTrueSkyPlugin::OnSequenceStreamed(FStringAssetReference Sequence)
+{
+	UTrueSkySequenceAsset *Asset=Cast<UTrueSkySequenceAsset>(Sequence.ResolveObject());
+	if(Asset)
+		PrefetchSequence(Asset);
+	else
+		UE_LOG(TrueSky, Warning, TEXT("Failed to stream sequence %s"), *Sequence.ToString());
+}
+
+void FTrueSkyPlugin::ReleaseSequence(const FStringAssetReference &Sequence)
+{
+	if(!Sequence.IsValid())
+		return;
+	// Its prepared copy would otherwise outlive it in the pipeline.
+	ForgetSequence(Cast<UTrueSkySequenceAsset>(Sequence.ResolveObject()));
+	sequenceStreamer.Unload(Sequence);
+}
+
+void FTrueSkyPlugin::ForgetSequence(UTrueSkySequenceAsset* Sequence)
+{
+	if(Sequence)
+		sequencePipeline.Forget(Sequence);
+}
+
 void FTrueSkyPlugin::OpenEditor(UTrueSkySequenceAsset* const TrueSkySequence)
 {
 }
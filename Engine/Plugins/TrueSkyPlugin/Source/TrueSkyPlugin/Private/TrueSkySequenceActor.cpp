@@ -1,13 +1,35 @@
 #include "TrueSkyPluginPrivatePCH.h"
 #include "TrueSkySequenceActor.h"
 #include "ActorCrossThreadProperties.h"
+#include "SkyCrossThreadSnapshot.h"
+#include "Kismet/KismetMaterialLibrary.h"
+#include "TrueSkyWeatherGrid.h"
+#include "TrueSkyCoverageMapStreamer.h"
+#include "TrueSkyKeyframeStreamer.h"
+#include "TrueSkySequenceAsset.h"
 
 ATrueSkySequenceActor::ATrueSkySequenceActor(const class FPostConstructInitializeProperties& PCIP)
-	: Super(PCIP),SimpleCloudShadowing(0.5f),Visible(true)
+	: Super(PCIP),CloudShadowRenderTarget(NULL),CloudShadowParameters(NULL),SimpleCloudShadowing(0.5f),CloudShadowRange(1000000.0f),Visible(true),CloudDepthOutput(false),CloudDepthDownscale(4)
+	,PrecipitationRenderTarget(NULL),PrecipitationMapSize(400000.0f),PrecipitationMapUpdateInterval(0.5f),PrecipitationParameters(NULL)
+	,UseEphemeris(false),Latitude(51.5f),Longitude(0.0f),UTCTime(2014,6,21,12),EphemerisTimeScale(1.0f)
+	,CoverageInputSize(20000000.0f),CoverageInputResolution(256),WeatherDataUpdateInterval(2.0f)
+	,InsideCloudMode(true),InsideCloudThreshold(0.05f),InsideCloudBlendTime(1.0f)
+	,AboveCloudMode(false),AboveCloudMargin(50000.0f),AboveCloudRaymarchDistance(2000000.0f),AboveCloudHeightfieldRange(20000000.0f)
+	,CloudLayerFastPath(true),CloudLayerFastPathAltitude(800000.0f),CloudLayerFastPathDensity(0.05f)
+	,CloudUpdateInterval(0.0f),Cloud2DUpdateInterval(1.0f)
+	,EmptySpaceSkipping(true),AdaptiveSkyPaths(true),CullToVisibility(false)
+	,SunLight(NULL),ScaleShadowBudget(false),OvercastShadowBudget(0.5f),NightShadowBudget(0.25f)
+	,CoverageMap(NULL),CoverageMapRange(3000000.0f),CoverageMapResidentTiles(64),CoverageMapUploadsPerFrame(2)
+	,PrecipitationMapTimer(0.0f),PrecipitationMapOrigin(0.0f,0.0f)
+	,WeatherGrid(NULL),WeatherGridTexels(NULL),WeatherGridOrigin(0.0f,0.0f),WeatherDataTimer(0.0f)
+	,CoverageMapStreamer(NULL)
+	,KeyframeWindowBlocks(3),KeyframeStreamer(NULL)
+	,ShadowBudgetTier(SHADOW_BUDGET_FULL),ShadowBudgetHoldTime(0.0f)
+	,FullShadowCascades(0),FullShadowDistance(0.0f),FullShadowResolutionScale(1.0f)
 {
-	trueSkyComponent=ConstructObject<UTrueSkyComponent>(UTrueSkyComponent::StaticClass());
-	// We register the TrueSkyComponent. This is created so the Actor (game thread) can talk to the plugin (render thread).
-	AddOwnedComponent(trueSkyComponent);
+	// The TrueSkyComponent is how the actor (game thread) talks to the plugin (render thread).
+	trueSkyComponent=PCIP.CreateDefaultSubobject<UTrueSkyComponent>(this,TEXT("TrueSkyComponent"));
+	WeatherScheduler=PCIP.CreateDefaultSubobject<UTrueSkyWeatherScheduler>(this,TEXT("WeatherScheduler"));
 	PrimaryActorTick.bTickEvenWhenPaused	=true;
 	PrimaryActorTick.bCanEverTick			=true;
 	PrimaryActorTick.bStartWithTickEnabled	=true;
@@ -17,9 +39,9 @@ ATrueSkySequenceActor::ATrueSkySequenceActor(const class FPostConstructInitializ
 
 ATrueSkySequenceActor::~ATrueSkySequenceActor()
 {
-	ActorCrossThreadProperties *A	=GetActorCrossThreadProperties();
-	if(A)
-		A->Destroyed=true;
+	ReleaseWeatherData();
+	delete CoverageMapStreamer;
+	delete KeyframeStreamer;
 }
 
 void ATrueSkySequenceActor::PostInitProperties()
@@ -42,10 +64,17 @@ void ATrueSkySequenceActor::PostInitializeComponents()
 
 void ATrueSkySequenceActor::Destroyed()
 {
-	ActorCrossThreadProperties *A	=GetActorCrossThreadProperties();
-	if(!A)
-		return;
-	A->Destroyed=true;
+	ReleaseWeatherData();
+	if(ITrueSkyPlugin::IsAvailable())
+	{
+		ITrueSkyPlugin::Get().ReleaseSequence(PendingSequence.ToStringReference());
+		ITrueSkyPlugin::Get().ReleaseSequence(StreamedSequence.ToStringReference());
+	}
+	PendingSequence=StreamedSequence=TAssetPtr<UTrueSkySequenceAsset>();
+	if(CoverageMapStreamer)
+		CoverageMapStreamer->Reset();
+	if(KeyframeStreamer)
+		KeyframeStreamer->Reset();
 	AActor::Destroyed();
 }
 
@@ -97,8 +126,15 @@ void ATrueSkySequenceActor::SetKeyframeInt(uint32 k,FString name, int32 value )
 
 FRotator ATrueSkySequenceActor::GetSunRotation() const
 {
-	float azimuth	=ITrueSkyPlugin::Get().GetRenderFloat("SunAzimuthDegrees");
-	float elevation	=ITrueSkyPlugin::Get().GetRenderFloat("SunElevationDegrees");
+	if(UseEphemeris)
+		return FRotator(-Ephemeris.SunElevation,-Ephemeris.SunAzimuth,0.0f);
+	return GetRuntimeSunRotation(ITrueSkyPlugin::Get());
+}
+
+FRotator ATrueSkySequenceActor::GetRuntimeSunRotation(ITrueSkyPlugin &TrueSkyPlugin)
+{
+	float azimuth	=TrueSkyPlugin.GetRenderFloat("SunAzimuthDegrees");
+	float elevation	=TrueSkyPlugin.GetRenderFloat("SunElevationDegrees");
 	FRotator sunRotation(-elevation,-azimuth,0.0f);
 	return sunRotation;
 }
@@ -111,21 +147,407 @@ FLinearColor ATrueSkySequenceActor::GetSunColor() const
 	return 0.5f*FLinearColor( r, g, b );
 }
 
+FRotator ATrueSkySequenceActor::GetMoonRotation() const
+{
+	if(UseEphemeris)
+		return FRotator(-Ephemeris.MoonElevation,-Ephemeris.MoonAzimuth,0.0f);
+	return GetRuntimeMoonRotation(ITrueSkyPlugin::Get());
+}
+
+FRotator ATrueSkySequenceActor::GetRuntimeMoonRotation(ITrueSkyPlugin &TrueSkyPlugin)
+{
+	float azimuth	=TrueSkyPlugin.GetRenderFloat("MoonAzimuthDegrees");
+	float elevation	=TrueSkyPlugin.GetRenderFloat("MoonElevationDegrees");
+	return FRotator(-elevation,-azimuth,0.0f);
+}
+
+float ATrueSkySequenceActor::GetSunVisibility() const
+{
+	return GetSkyCrossThreadSnapshot().SunVisibility;
+}
+
+float ATrueSkySequenceActor::GetMoonVisibility() const
+{
+	return GetSkyCrossThreadSnapshot().MoonVisibility;
+}
+
+float ATrueSkySequenceActor::GetVisibilityDistance() const
+{
+	return GetSkyCrossThreadSnapshot().VisibilityDistance;
+}
+
+void ATrueSkySequenceActor::PrefetchAlternateSequence(int32 Index)
+{
+	if(AlternateSequences.IsValidIndex(Index)&&!AlternateSequences[Index].IsNull())
+		ITrueSkyPlugin::Get().StreamSequence(AlternateSequences[Index].ToStringReference());
+}
+
+void ATrueSkySequenceActor::SwitchToAlternateSequence(int32 Index)
+{
+	if(!AlternateSequences.IsValidIndex(Index)||AlternateSequences[Index].IsNull())
+		return;
+	PendingSequence=AlternateSequences[Index];
+	ITrueSkyPlugin::Get().StreamSequence(PendingSequence.ToStringReference());
+}
+
+void ATrueSkySequenceActor::UpdatePendingSequence()
+{
+	if(PendingSequence.IsNull())
+		return;
+	UTrueSkySequenceAsset *Sequence=PendingSequence.Get();
+	if(!Sequence)
+		return;
+	// ActiveSequence holds it from here on; the streamer needn't keep the previous alternate.
+	ActiveSequence=Sequence;
+	if(!StreamedSequence.IsNull()&&!(StreamedSequence.ToStringReference()==PendingSequence.ToStringReference()))
+		ITrueSkyPlugin::Get().ReleaseSequence(StreamedSequence.ToStringReference());
+	StreamedSequence=PendingSequence;
+	PendingSequence=TAssetPtr<UTrueSkySequenceAsset>();
+}
+
+void ATrueSkySequenceActor::UpdateKeyframeWindow()
+{
+	if(GetNetMode()==NM_DedicatedServer||!ITrueSkyPlugin::IsAvailable()||!trueSkyComponent)
+		return;
+	if(!KeyframeStreamer)
+	{
+		// Only cooked sequences have blocks to stream.
+		if(!ActiveSequence||ActiveSequence->GetNumKeyframeBlocks()==0)
+			return;
+		KeyframeStreamer=new FTrueSkyKeyframeStreamer;
+	}
+	int32 Window;
+	TArray<uint8> Text;
+	if(KeyframeStreamer->Update(ActiveSequence,GetFloat("time"),KeyframeWindowBlocks,Window,Text))
+		trueSkyComponent->SetSequenceWindow(Window,Text);
+}
+
 void ATrueSkySequenceActor::TransferProperties()
 {
-	ActorCrossThreadProperties *A	=GetActorCrossThreadProperties();
-	if(!A)
+	if(!trueSkyComponent)
 		return;
-	A->Destroyed			=false;
+	ActorCrossThreadProperties *A	=&trueSkyComponent->GetProperties();
 	A->Visible				=Visible;
 	A->SimpleCloudShadowing	=SimpleCloudShadowing;
 	A->activeSequence		=ActiveSequence;
 	A->SimpleCloudShadowSharpness=SimpleCloudShadowSharpness;
+	A->CloudShadowRange		=CloudShadowRange;
+	A->InsideCloudMode		=InsideCloudMode;
+	A->InsideCloudThreshold	=InsideCloudThreshold;
+	A->InsideCloudBlendTime	=InsideCloudBlendTime;
+	A->AboveCloudMode		=AboveCloudMode;
+	A->AboveCloudMargin		=AboveCloudMargin;
+	A->AboveCloudRaymarchDistance=AboveCloudRaymarchDistance;
+	A->AboveCloudHeightfieldRange=AboveCloudHeightfieldRange;
+	A->CloudLayerFastPath	=CloudLayerFastPath;
+	A->CloudLayerFastPathAltitude=CloudLayerFastPathAltitude;
+	A->CloudLayerFastPathDensity=CloudLayerFastPathDensity;
+	A->CloudUpdateInterval	=CloudUpdateInterval;
+	A->Cloud2DUpdateInterval=Cloud2DUpdateInterval;
+	A->EmptySpaceSkipping	=EmptySpaceSkipping;
+	A->AdaptiveSkyPaths		=AdaptiveSkyPaths;
+	A->CullToVisibility		=CullToVisibility;
+	A->CloudDepthOutput		=CloudDepthOutput;
+	A->CloudDepthDownscale	=CloudDepthDownscale;
+	A->PrecipitationTarget	=PrecipitationRenderTarget?PrecipitationRenderTarget->GameThread_GetRenderTargetResource():NULL;
+	A->PrecipitationMapSize	=PrecipitationMapSize;
+	A->CloudShadowTarget	=CloudShadowRenderTarget?CloudShadowRenderTarget->GameThread_GetRenderTargetResource():NULL;
+	trueSkyComponent->PropertiesChanged();
+}
+
+void ATrueSkySequenceActor::UpdateCloudShadowMap()
+{
+	if(!CloudShadowRenderTarget||CloudShadowRange<=0.0f)
+		return;
+	FVector centre=GetActorLocation();
+	UWorld *World=GetWorld();
+	APlayerController *PlayerController=World?World->GetFirstPlayerController():NULL;
+	if(PlayerController&&PlayerController->PlayerCameraManager)
+		centre=PlayerController->PlayerCameraManager->GetCameraLocation();
+	// Snap to whole texels, so the shadow doesn't shimmer as the camera moves.
+	float size=2.0f*CloudShadowRange;
+	float texel=size/(float)FMath::Max(1,CloudShadowRenderTarget->SizeX);
+	FVector2D Origin(FMath::FloorToFloat(centre.X/texel)*texel-0.5f*size,FMath::FloorToFloat(centre.Y/texel)*texel-0.5f*size);
+	if(trueSkyComponent)
+	{
+		trueSkyComponent->GetProperties().CloudShadowOrigin=Origin;
+		trueSkyComponent->PropertiesChanged();
+	}
+	if(CloudShadowParameters)
+	{
+		UKismetMaterialLibrary::SetVectorParameterValue(this,CloudShadowParameters,TEXT("CloudShadowTransform")
+			,FLinearColor(-Origin.X/size,-Origin.Y/size,1.0f/size,1.0f/size));
+	}
 }
 	
+void ATrueSkySequenceActor::UpdatePrecipitationMap(float DeltaTime)
+{
+	if(!PrecipitationRenderTarget)
+		return;
+	PrecipitationMapTimer-=DeltaTime;
+	if(PrecipitationMapTimer>0.0f)
+		return;
+	PrecipitationMapTimer=PrecipitationMapUpdateInterval;
+	FVector centre=GetActorLocation();
+	UWorld *World=GetWorld();
+	APlayerController *PlayerController=World?World->GetFirstPlayerController():NULL;
+	if(PlayerController&&PlayerController->PlayerCameraManager)
+		centre=PlayerController->PlayerCameraManager->GetCameraLocation();
+	// Snap to whole texels, so the map doesn't shimmer as the camera moves.
+	float texel=PrecipitationMapSize/(float)FMath::Max(1,PrecipitationRenderTarget->SizeX);
+	PrecipitationMapOrigin.X=FMath::FloorToFloat((centre.X-0.5f*PrecipitationMapSize)/texel)*texel;
+	PrecipitationMapOrigin.Y=FMath::FloorToFloat((centre.Y-0.5f*PrecipitationMapSize)/texel)*texel;
+	if(trueSkyComponent)
+	{
+		ActorCrossThreadProperties &A=trueSkyComponent->GetProperties();
+		A.PrecipitationMapOrigin=PrecipitationMapOrigin;
+		A.PrecipitationMapUpdate++;
+		trueSkyComponent->PropertiesChanged();
+	}
+	if(PrecipitationParameters)
+	{
+		UKismetMaterialLibrary::SetVectorParameterValue(this,PrecipitationParameters,TEXT("PrecipitationMapOrigin")
+			,FLinearColor(PrecipitationMapOrigin.X,PrecipitationMapOrigin.Y,PrecipitationMapSize,0.0f));
+	}
+}
+
+void ATrueSkySequenceActor::GetEphemeris(float &SunAzimuth,float &SunElevation,float &MoonAzimuth,float &MoonElevation,float &MoonPhase) const
+{
+	SunAzimuth		=Ephemeris.SunAzimuth;
+	SunElevation	=Ephemeris.SunElevation;
+	MoonAzimuth		=Ephemeris.MoonAzimuth;
+	MoonElevation	=Ephemeris.MoonElevation;
+	MoonPhase		=Ephemeris.MoonPhase;
+}
+
+void ATrueSkySequenceActor::UpdateEphemeris(float DeltaTime)
+{
+	if(!UseEphemeris)
+		return;
+	UTCTime+=FTimespan::FromSeconds(DeltaTime*EphemerisTimeScale);
+	Ephemeris=FTrueSkyEphemeris::Compute(Latitude,Longitude,UTCTime);
+	// Servers have no renderer to drive, but still get the sun and moon for gameplay.
+	if(GetNetMode()==NM_DedicatedServer||!ITrueSkyPlugin::IsAvailable())
+		return;
+	ITrueSkyPlugin &TrueSkyPlugin=ITrueSkyPlugin::Get();
+	// trueSKY's time is in days; use local mean solar time so midday is near the sun's transit.
+	double localDays=UTCTime.GetTimeOfDay().GetTotalHours()/24.0+Longitude/360.0;
+	TrueSkyPlugin.SetRenderFloat("time",(float)(localDays-FMath::FloorToDouble(localDays)));
+	TrueSkyPlugin.SetRenderFloat("SunAzimuthDegrees",Ephemeris.SunAzimuth);
+	TrueSkyPlugin.SetRenderFloat("SunElevationDegrees",Ephemeris.SunElevation);
+	TrueSkyPlugin.SetRenderFloat("MoonAzimuthDegrees",Ephemeris.MoonAzimuth);
+	TrueSkyPlugin.SetRenderFloat("MoonElevationDegrees",Ephemeris.MoonElevation);
+	TrueSkyPlugin.SetRenderFloat("MoonPhase",Ephemeris.MoonPhase);
+}
+
+/** Samples the weather grid around the camera on a worker thread. */
+class FTrueSkyWeatherGridTask
+{
+	const FTrueSkyWeatherGrid &Grid;
+	FDateTime Time;
+	double Latitude,Longitude;
+	FVector2D Origin;
+	float Size;
+	int32 Resolution;
+	TArray<FFloat16Color> &Texels;
+
+public:
+	FTrueSkyWeatherGridTask(const FTrueSkyWeatherGrid &InGrid,const FDateTime &InTime,double InLatitude,double InLongitude,const FVector2D &InOrigin,float InSize,int32 InResolution,TArray<FFloat16Color> &OutTexels)
+		:Grid(InGrid)
+		,Time(InTime)
+		,Latitude(InLatitude)
+		,Longitude(InLongitude)
+		,Origin(InOrigin)
+		,Size(InSize)
+		,Resolution(InResolution)
+		,Texels(OutTexels)
+	{
+	}
+
+	FORCEINLINE TStatId GetStatId() const
+	{
+		RETURN_QUICK_DECLARE_CYCLE_STAT(FTrueSkyWeatherGridTask, STATGROUP_TaskGraphTasks);
+	}
+
+	ENamedThreads::Type GetDesiredThread()
+	{
+		return ENamedThreads::AnyThread;
+	}
+
+	static ESubsequentsMode::Type GetSubsequentsMode() { return ESubsequentsMode::TrackSubsequents; }
+
+	void DoTask(ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+	{
+		Grid.Sample(Time,Latitude,Longitude,Origin,Size,Resolution,Texels);
+	}
+};
+
+void ATrueSkySequenceActor::ReleaseWeatherData()
+{
+	if(WeatherGridTask.GetReference())
+		FTaskGraphInterface::Get().WaitUntilTaskCompletes(WeatherGridTask);
+	WeatherGridTask=NULL;
+	delete WeatherGridTexels;
+	WeatherGridTexels=NULL;
+	delete WeatherGrid;
+	WeatherGrid=NULL;
+	WeatherGridFile.Empty();
+}
+
+void ATrueSkySequenceActor::UpdateWeatherData(float DeltaTime)
+{
+	if(GetNetMode()==NM_DedicatedServer||!ITrueSkyPlugin::IsAvailable()||CoverageMap)
+		return;
+	ITrueSkyPlugin &TrueSkyPlugin=ITrueSkyPlugin::Get();
+	// Hand over a finished sample; the plugin owns the texels from here.
+	if(WeatherGridTask.GetReference()&&WeatherGridTask->IsComplete())
+	{
+		WeatherGridTask=NULL;
+		int32 Resolution=FMath::Sqrt((float)WeatherGridTexels->Num());
+		TrueSkyPlugin.UpdateCloudCoverageInput(Resolution,Resolution,WeatherGridOrigin,CoverageInputSize,false,FIntRect(0,0,Resolution,Resolution),WeatherGridTexels);
+		WeatherGridTexels=NULL;
+	}
+	if(WeatherDataFile!=WeatherGridFile)
+	{
+		bool HadGrid=WeatherGrid!=NULL;
+		ReleaseWeatherData();
+		WeatherGridFile=WeatherDataFile;
+		if(!WeatherDataFile.IsEmpty())
+		{
+			WeatherGrid=new FTrueSkyWeatherGrid;
+			if(!WeatherGrid->Open(FPaths::Combine(*FPaths::GameDir(),*WeatherDataFile)))
+			{
+				delete WeatherGrid;
+				WeatherGrid=NULL;
+			}
+		}
+		if(HadGrid&&!WeatherGrid)
+			TrueSkyPlugin.UpdateCloudCoverageInput(0,0,FVector2D(0.0f,0.0f),0.0f,false,FIntRect(),NULL);
+		WeatherDataTimer=0.0f;
+	}
+	if(!WeatherGrid||WeatherGridTask.GetReference())
+		return;
+	WeatherDataTimer-=DeltaTime;
+	if(WeatherDataTimer>0.0f)
+		return;
+	WeatherDataTimer=WeatherDataUpdateInterval;
+	FVector centre=GetActorLocation();
+	UWorld *World=GetWorld();
+	APlayerController *PlayerController=World?World->GetFirstPlayerController():NULL;
+	if(PlayerController&&PlayerController->PlayerCameraManager)
+		centre=PlayerController->PlayerCameraManager->GetCameraLocation();
+	// The window moves in steps of an eighth of its size, so it only shifts occasionally as the camera travels.
+	float step=CoverageInputSize/8.0f;
+	WeatherGridOrigin.X=FMath::FloorToFloat(centre.X/step)*step-0.5f*CoverageInputSize;
+	WeatherGridOrigin.Y=FMath::FloorToFloat(centre.Y/step)*step-0.5f*CoverageInputSize;
+	WeatherGridTexels=new TArray<FFloat16Color>;
+	WeatherGridTask=TGraphTask<FTrueSkyWeatherGridTask>::CreateTask().ConstructAndDispatchWhenReady(*WeatherGrid,UTCTime,Latitude,Longitude
+		,WeatherGridOrigin,CoverageInputSize,CoverageInputResolution,*WeatherGridTexels);
+}
+
+void ATrueSkySequenceActor::UpdateCoverageMap()
+{
+	if(GetNetMode()==NM_DedicatedServer)
+		return;
+	if(!CoverageMap)
+	{
+		if(CoverageMapStreamer)
+			CoverageMapStreamer->Reset();
+		return;
+	}
+	if(!CoverageMapStreamer)
+		CoverageMapStreamer=new FTrueSkyCoverageMapStreamer;
+	FVector centre=GetActorLocation();
+	UWorld *World=GetWorld();
+	APlayerController *PlayerController=World?World->GetFirstPlayerController():NULL;
+	if(PlayerController&&PlayerController->PlayerCameraManager)
+		centre=PlayerController->PlayerCameraManager->GetCameraLocation();
+	CoverageMapStreamer->Update(CoverageMap,centre,CoverageMapRange,CoverageMapResidentTiles,CoverageMapUploadsPerFrame);
+}
+
+void ATrueSkySequenceActor::ApplyShadowBudget(UDirectionalLightComponent *Light,float Budget)
+{
+	Light->DynamicShadowCascades				=FMath::Max(1,FMath::RoundToInt(FullShadowCascades*Budget));
+	Light->DynamicShadowDistanceMovableLight	=FullShadowDistance*Budget;
+	Light->ShadowResolutionScale				=FullShadowResolutionScale*FMath::Max(0.25f,Budget);
+	Light->MarkRenderStateDirty();
+}
+
+void ATrueSkySequenceActor::UpdateShadowBudget(float DeltaTime)
+{
+	UDirectionalLightComponent *Light=SunLight?Cast<UDirectionalLightComponent>(SunLight->GetLightComponent()):NULL;
+	// Give the previous light back its own settings.
+	if(ShadowBudgetLight.IsValid()&&(ShadowBudgetLight.Get()!=Light||!ScaleShadowBudget))
+	{
+		if(ShadowBudgetTier!=SHADOW_BUDGET_FULL)
+			ApplyShadowBudget(ShadowBudgetLight.Get(),1.0f);
+		ShadowBudgetLight=NULL;
+		ShadowBudgetTier=SHADOW_BUDGET_FULL;
+	}
+	if(!Light||!ScaleShadowBudget||GetNetMode()==NM_DedicatedServer||!ITrueSkyPlugin::IsAvailable())
+		return;
+	if(ShadowBudgetLight.Get()!=Light)
+	{
+		ShadowBudgetLight			=Light;
+		FullShadowCascades			=Light->DynamicShadowCascades;
+		FullShadowDistance			=Light->DynamicShadowDistanceMovableLight;
+		FullShadowResolutionScale	=Light->ShadowResolutionScale;
+	}
+	// Thresholds are further apart for leaving a tier than entering it, and a tier is held for a while,
+	// so a flickering readback or a sun on the horizon doesn't make the shadows pop back and forth.
+	static const float NightEnterElevation		=-2.0f;
+	static const float NightLeaveElevation		=2.0f;
+	static const float OvercastEnterVisibility	=0.15f;
+	static const float OvercastLeaveVisibility	=0.35f;
+	static const float MinHoldTime				=3.0f;
+	static const float MinRotationChange		=0.05f;
+	FRotator SunRotation	=GetSunRotation();
+	float SunElevation		=-SunRotation.Pitch;
+	float SunVisibility		=GetSunVisibility();
+	EShadowBudgetTier Tier	=ShadowBudgetTier;
+	if(Tier==SHADOW_BUDGET_NIGHT)
+	{
+		if(SunElevation>NightLeaveElevation)
+			Tier=SunVisibility<OvercastLeaveVisibility?SHADOW_BUDGET_OVERCAST:SHADOW_BUDGET_FULL;
+	}
+	else if(SunElevation<NightEnterElevation)
+		Tier=SHADOW_BUDGET_NIGHT;
+	else if(Tier==SHADOW_BUDGET_FULL&&SunVisibility<OvercastEnterVisibility)
+		Tier=SHADOW_BUDGET_OVERCAST;
+	else if(Tier==SHADOW_BUDGET_OVERCAST&&SunVisibility>OvercastLeaveVisibility)
+		Tier=SHADOW_BUDGET_FULL;
+	ShadowBudgetHoldTime+=DeltaTime;
+	if(Tier!=ShadowBudgetTier&&ShadowBudgetHoldTime>=MinHoldTime)
+	{
+		ShadowBudgetTier		=Tier;
+		ShadowBudgetHoldTime	=0.0f;
+		float Budget=Tier==SHADOW_BUDGET_NIGHT?NightShadowBudget:(Tier==SHADOW_BUDGET_OVERCAST?OvercastShadowBudget:1.0f);
+		ApplyShadowBudget(Light,Budget);
+	}
+	// At night the moon casts the shadows. Static and stationary lights can't be turned at runtime, and turning a
+	// movable one redoes its shadows, so only when it has moved noticeably.
+	FRotator Rotation=ShadowBudgetTier==SHADOW_BUDGET_NIGHT?GetMoonRotation():SunRotation;
+	if(Light->Mobility==EComponentMobility::Movable&&!SunLight->GetActorRotation().Equals(Rotation,MinRotationChange))
+		SunLight->SetActorRotation(Rotation);
+}
+
 void ATrueSkySequenceActor::TickActor(float DeltaTime,enum ELevelTick TickType,FActorTickFunction& ThisTickFunction)
 {
+	if(WeatherScheduler&&GetNetMode()!=NM_DedicatedServer)
+	{
+		UTrueSkySequenceAsset *WeatherSequence=WeatherScheduler->Update(DeltaTime);
+		if(WeatherSequence)
+			ActiveSequence=WeatherSequence;
+	}
+	UpdatePendingSequence();
 	TransferProperties();
+	UpdateKeyframeWindow();
+	UpdatePrecipitationMap(DeltaTime);
+	UpdateCloudShadowMap();
+	UpdateEphemeris(DeltaTime);
+	UpdateWeatherData(DeltaTime);
+	UpdateCoverageMap();
+	UpdateShadowBudget(DeltaTime);
 }
 
 
@@ -1,9 +1,112 @@
 #include "TrueSkyPluginPrivatePCH.h"
 #include "TrueSkySequenceAsset.h"
+#include "TrueSkySequenceKeyframes.h"
+#include "TrueSkyBulkData.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkySequence, Log, All);
 
 UTrueSkySequenceAsset::UTrueSkySequenceAsset(const class FPostConstructInitializeProperties& PCIP)
 	: Super(PCIP)
+	,SimplifyKeyframes(false)
+	,KeyframeTolerance(0.001f)
+	,StreamKeyframes(false)
+	,KeyframeBlockDays(0.25f)
+{
+
+}
+
+void UTrueSkySequenceAsset::BeginDestroy()
 {
+	// The sequence pipeline keys on the asset's address, which a later asset may reuse.
+	if(ITrueSkyPlugin::IsAvailable())
+		ITrueSkyPlugin::Get().ForgetSequence(this);
+	Super::BeginDestroy();
+}
 
+bool UTrueSkySequenceAsset::GetSequenceText(TArray<uint8> &OutText)
+{
+	if(SequenceText.Num()>0)
+	{
+		OutText=SequenceText;
+		return true;
+	}
+	return FTrueSkyBulkData::Copy(CookedSequenceText,BulkDataFilename,OutText);
 }
 
+bool UTrueSkySequenceAsset::GetKeyframeBlock(int32 Index,TArray<uint8> &OutBlock)
+{
+	if(!KeyframeBlocks.IsValidIndex(Index))
+		return false;
+	return FTrueSkyBulkData::Copy(KeyframeBlocks[Index],BulkDataFilename,OutBlock);
+}
+
+void UTrueSkySequenceAsset::SimplifyForCooking(TArray<uint8> &Text) const
+{
+	TMap<FString,float> Tolerances;
+	for(int32 i=0;i<KeyframeTolerances.Num();i++)
+		Tolerances.Add(KeyframeTolerances[i].Name,KeyframeTolerances[i].Tolerance);
+	TArray<uint8> Simplified;
+	FTrueSkySequenceKeyframes::FSimplifyStats Stats;
+	if(!FTrueSkySequenceKeyframes::Simplify(Text,KeyframeTolerance,Tolerances,Simplified,Stats))
+	{
+		UE_LOG(TrueSkySequence, Warning, TEXT("%s: keyframes can't be simplified"), *GetName());
+		return;
+	}
+	// Loading and evaluating the sequence scale with its keyframes; the parse is timed here as a measure of both.
+	UE_LOG(TrueSkySequence, Log, TEXT("%s: simplified keyframes from %d to %d (%d removed); parse %.2fms to %.2fms, %.2fx faster; text %d to %d bytes")
+		, *GetName(), Stats.KeyframesBefore, Stats.KeyframesAfter, Stats.KeyframesBefore-Stats.KeyframesAfter
+		, Stats.ParseSecondsBefore*1000.0, Stats.ParseSecondsAfter*1000.0
+		, Stats.ParseSecondsAfter>0.0?Stats.ParseSecondsBefore/Stats.ParseSecondsAfter:1.0
+		, Text.Num(), Simplified.Num());
+	Exchange(Text,Simplified);
+}
+
+void UTrueSkySequenceAsset::Serialize(FArchive& Ar)
+{
+	// Cooking moves the text out of the property and into bulk data, which the runtime can drop and reload.
+	bool Cooking=Ar.IsSaving()&&Ar.IsCooking();
+	TArray<uint8> Text;
+	if(Cooking)
+		Exchange(Text,SequenceText);
+	Super::Serialize(Ar);
+	if(Cooking)
+	{
+		Exchange(Text,SequenceText);
+		// Text becomes the cooked text; SequenceText, the editor's, is left as it is.
+		Text=SequenceText;
+		if(SimplifyKeyframes)
+			SimplifyForCooking(Text);
+		TArray<uint8> Coarse;
+		TArray< TArray<uint8> > Blocks;
+		KeyframeBlocks.Empty();
+		if(StreamKeyframes&&FTrueSkySequenceKeyframes::Split(Text,KeyframeBlockDays,Coarse,Blocks))
+		{
+			FTrueSkyBulkData::Store(CookedSequenceText,Coarse);
+			for(int32 i=0;i<Blocks.Num();i++)
+				FTrueSkyBulkData::Store(KeyframeBlocks[KeyframeBlocks.Add(new FByteBulkData)],Blocks[i]);
+			UE_LOG(TrueSkySequence, Log, TEXT("%s: keyframes cooked into %d blocks of %g days"), *GetName(), Blocks.Num(), KeyframeBlockDays);
+		}
+		else
+		{
+			if(StreamKeyframes)
+				UE_LOG(TrueSkySequence, Warning, TEXT("%s: keyframes can't be split into blocks of %g days, so won't be streamed"), *GetName(), KeyframeBlockDays);
+			FTrueSkyBulkData::Store(CookedSequenceText,Text);
+		}
+	}
+	if(Cooking||(Ar.IsLoading()&&FPlatformProperties::RequiresCookedData()))
+	{
+		if(Ar.IsLoading())
+			BulkDataFilename=FTrueSkyBulkData::GetPackageFilename(this,Ar);
+		CookedSequenceText.Serialize(Ar,this);
+		int32 NumBlocks=KeyframeBlocks.Num();
+		Ar<<NumBlocks;
+		if(Ar.IsLoading())
+		{
+			KeyframeBlocks.Empty(NumBlocks);
+			for(int32 i=0;i<NumBlocks;i++)
+				KeyframeBlocks.Add(new FByteBulkData);
+		}
+		for(int32 i=0;i<NumBlocks;i++)
+			KeyframeBlocks[i].Serialize(Ar,this);
+	}
+}
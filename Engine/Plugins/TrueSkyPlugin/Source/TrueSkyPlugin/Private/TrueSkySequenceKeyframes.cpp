@@ -0,0 +1,287 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkySequenceKeyframes.h"
+#include "Json.h"
+
+typedef TArray< TSharedPtr<FJsonValue> > FKeyframeArray;
+typedef TCondensedJsonPrintPolicy<TCHAR> FSequencePrintPolicy;
+
+static bool ReadJson(const TArray<uint8> &Text,TSharedPtr<FJsonObject> &OutObject)
+{
+	if(Text.Num()==0)
+		return false;
+	// The text is ANSI, as the dll takes it, and may or may not be terminated.
+	TArray<ANSICHAR> Terminated;
+	Terminated.Append((const ANSICHAR*)Text.GetData(),Text.Num());
+	Terminated.Add(0);
+	TSharedRef< TJsonReader<TCHAR> > Reader=TJsonReaderFactory<TCHAR>::Create(ANSI_TO_TCHAR(Terminated.GetData()));
+	return FJsonSerializer::Deserialize(Reader,OutObject)&&OutObject.IsValid();
+}
+
+static void WriteJson(const TSharedPtr<FJsonObject> &Object,TArray<uint8> &OutText)
+{
+	FString String;
+	TSharedRef< TJsonWriter<TCHAR,FSequencePrintPolicy> > Writer=TJsonWriterFactory<TCHAR,FSequencePrintPolicy>::Create(&String);
+	FJsonSerializer::Serialize(Object.ToSharedRef(),Writer);
+	FTCHARToANSI Converted(*String);
+	OutText.Empty(Converted.Length()+1);
+	OutText.Append((const uint8*)Converted.Get(),Converted.Length());
+	OutText.Add(0);
+}
+
+/** The keyframe's time in days, or a negative value if it has none. */
+static double GetKeyframeTime(const TSharedPtr<FJsonValue> &Keyframe)
+{
+	if(!Keyframe.IsValid()||Keyframe->Type!=EJson::Object)
+		return -1.0;
+	TSharedPtr<FJsonObject> Object=Keyframe->AsObject();
+	if(!Object->HasTypedField<EJson::Number>(TEXT("daytime")))
+		return -1.0;
+	return Object->GetNumberField(TEXT("daytime"));
+}
+
+struct FKeyframeTimeLess
+{
+	bool operator()(const TSharedPtr<FJsonValue> &A,const TSharedPtr<FJsonValue> &B) const
+	{
+		return GetKeyframeTime(A)<GetKeyframeTime(B);
+	}
+};
+
+/** Layer's keyframe array, or NULL if Value isn't a layer. */
+static const FKeyframeArray *GetLayerKeyframes(const TSharedPtr<FJsonValue> &Value)
+{
+	if(!Value.IsValid()||Value->Type!=EJson::Object)
+		return NULL;
+	TSharedPtr<FJsonObject> Layer=Value->AsObject();
+	if(!Layer->HasTypedField<EJson::Array>(TEXT("keyframes")))
+		return NULL;
+	return &Layer->GetArrayField(TEXT("keyframes"));
+}
+
+bool FTrueSkySequenceKeyframes::Split(const TArray<uint8> &Text,float BlockDays,TArray<uint8> &OutCoarse,TArray< TArray<uint8> > &OutBlocks)
+{
+	TSharedPtr<FJsonObject> Sequence;
+	if(BlockDays<=0.0f||!ReadJson(Text,Sequence))
+		return false;
+	TArray< TSharedPtr<FJsonObject> > Blocks;
+	for(auto It=Sequence->Values.CreateConstIterator();It;++It)
+	{
+		const FKeyframeArray *Keyframes=GetLayerKeyframes(It.Value());
+		if(!Keyframes)
+			continue;
+		FKeyframeArray Sorted=*Keyframes;
+		Sorted.StableSort(FKeyframeTimeLess());
+		FKeyframeArray Coarse;
+		TArray<FKeyframeArray> LayerBlocks;
+		for(int32 i=0;i<Sorted.Num();i++)
+		{
+			double Time=GetKeyframeTime(Sorted[i]);
+			if(Time<0.0)
+			{
+				Coarse.Add(Sorted[i]);
+				continue;
+			}
+			int32 Block=(int32)(Time/BlockDays);
+			if(Block>=MaxBlocks)
+				return false;
+			if(Block>=LayerBlocks.Num())
+				LayerBlocks.SetNum(Block+1);
+			LayerBlocks[Block].Add(Sorted[i]);
+			// The ends of each block, so that the coarse curve spans the same times.
+			bool First	=i==0||GetKeyframeTime(Sorted[i-1])<Block*(double)BlockDays;
+			bool Last	=i+1==Sorted.Num()||GetKeyframeTime(Sorted[i+1])>=(Block+1)*(double)BlockDays;
+			if(First||Last)
+				Coarse.Add(Sorted[i]);
+		}
+		if(LayerBlocks.Num()>Blocks.Num())
+		{
+			for(int32 b=Blocks.Num();b<LayerBlocks.Num();b++)
+				Blocks.Add(MakeShareable(new FJsonObject));
+		}
+		for(int32 b=0;b<LayerBlocks.Num();b++)
+		{
+			if(LayerBlocks[b].Num())
+				Blocks[b]->SetArrayField(It.Key(),LayerBlocks[b]);
+		}
+		It.Value()->AsObject()->SetArrayField(TEXT("keyframes"),Coarse);
+	}
+	if(Blocks.Num()<2)
+		return false;
+	WriteJson(Sequence,OutCoarse);
+	OutBlocks.Empty(Blocks.Num());
+	OutBlocks.AddZeroed(Blocks.Num());
+	for(int32 b=0;b<Blocks.Num();b++)
+		WriteJson(Blocks[b],OutBlocks[b]);
+	return true;
+}
+
+bool FTrueSkySequenceKeyframes::Merge(const TArray<uint8> &Coarse,const TArray< TArray<uint8> > &Blocks,float StartDay,float EndDay,TArray<uint8> &OutText)
+{
+	TSharedPtr<FJsonObject> Sequence;
+	if(!ReadJson(Coarse,Sequence))
+		return false;
+	TArray< TSharedPtr<FJsonObject> > BlockObjects;
+	for(int32 b=0;b<Blocks.Num();b++)
+	{
+		TSharedPtr<FJsonObject> Block;
+		if(!ReadJson(Blocks[b],Block))
+			return false;
+		BlockObjects.Add(Block);
+	}
+	for(auto It=Sequence->Values.CreateConstIterator();It;++It)
+	{
+		const FKeyframeArray *Keyframes=GetLayerKeyframes(It.Value());
+		if(!Keyframes)
+			continue;
+		FKeyframeArray Merged;
+		for(int32 i=0;i<Keyframes->Num();i++)
+		{
+			double Time=GetKeyframeTime((*Keyframes)[i]);
+			if(Time<StartDay||Time>=EndDay)
+				Merged.Add((*Keyframes)[i]);
+		}
+		for(int32 b=0;b<BlockObjects.Num();b++)
+		{
+			if(BlockObjects[b]->HasTypedField<EJson::Array>(It.Key()))
+				Merged.Append(BlockObjects[b]->GetArrayField(It.Key()));
+		}
+		Merged.StableSort(FKeyframeTimeLess());
+		It.Value()->AsObject()->SetArrayField(TEXT("keyframes"),Merged);
+	}
+	WriteJson(Sequence,OutText);
+	return true;
+}
+
+/** How far Keyframe's values are from the line between Before and After, as a multiple of the tolerance; above 1 means it's needed. */
+static float GetKeyframeError(const FString &Layer,const TSharedPtr<FJsonObject> &Keyframe,const TSharedPtr<FJsonObject> &Before,const TSharedPtr<FJsonObject> &After
+	,double Alpha,float DefaultTolerance,const TMap<FString,float> &Tolerances)
+{
+	if(Keyframe->Values.Num()!=Before->Values.Num()||Keyframe->Values.Num()!=After->Values.Num())
+		return MAX_FLT;
+	float MaxError=0.0f;
+	for(auto It=Keyframe->Values.CreateConstIterator();It;++It)
+	{
+		const FString &Name=It.Key();
+		if(Name==TEXT("daytime")||Name==TEXT("uid"))
+			continue;
+		const TSharedPtr<FJsonValue> *A=Before->Values.Find(Name);
+		const TSharedPtr<FJsonValue> *B=After->Values.Find(Name);
+		if(!A||!B||(*A)->Type!=It.Value()->Type||(*B)->Type!=It.Value()->Type)
+			return MAX_FLT;
+		switch(It.Value()->Type)
+		{
+		case EJson::Number:
+			{
+				const float *Tolerance=Tolerances.Find(Layer+TEXT(".")+Name);
+				if(!Tolerance)
+					Tolerance=Tolerances.Find(Name);
+				if(!Tolerance)
+					Tolerance=Tolerances.Find(Layer);
+				double Interpolated	=(*A)->AsNumber()+((*B)->AsNumber()-(*A)->AsNumber())*Alpha;
+				double Error		=FMath::Abs(It.Value()->AsNumber()-Interpolated);
+				float Allowed		=Tolerance?*Tolerance:DefaultTolerance;
+				if(Allowed<=0.0f)
+				{
+					if(Error>0.0)
+						return MAX_FLT;
+				}
+				else
+					MaxError=FMath::Max(MaxError,(float)(Error/Allowed));
+			}
+			break;
+		case EJson::String:
+			if(It.Value()->AsString()!=(*A)->AsString()||It.Value()->AsString()!=(*B)->AsString())
+				return MAX_FLT;
+			break;
+		case EJson::Boolean:
+			if(It.Value()->AsBool()!=(*A)->AsBool()||It.Value()->AsBool()!=(*B)->AsBool())
+				return MAX_FLT;
+			break;
+		case EJson::Null:
+			break;
+		default:
+			// Arrays and objects aren't interpolated, so aren't compared either.
+			return MAX_FLT;
+		}
+	}
+	return MaxError;
+}
+
+bool FTrueSkySequenceKeyframes::Simplify(const TArray<uint8> &Text,float DefaultTolerance,const TMap<FString,float> &Tolerances,TArray<uint8> &OutText,FSimplifyStats &OutStats)
+{
+	TSharedPtr<FJsonObject> Sequence;
+	double StartTime=FPlatformTime::Seconds();
+	if(!ReadJson(Text,Sequence))
+		return false;
+	OutStats.ParseSecondsBefore	=FPlatformTime::Seconds()-StartTime;
+	OutStats.KeyframesBefore	=0;
+	OutStats.KeyframesAfter		=0;
+	for(auto It=Sequence->Values.CreateConstIterator();It;++It)
+	{
+		const FKeyframeArray *Keyframes=GetLayerKeyframes(It.Value());
+		if(!Keyframes)
+			continue;
+		FKeyframeArray Sorted;
+		FKeyframeArray Simplified;
+		for(int32 i=0;i<Keyframes->Num();i++)
+		{
+			if(GetKeyframeTime((*Keyframes)[i])<0.0)
+				Simplified.Add((*Keyframes)[i]);
+			else
+				Sorted.Add((*Keyframes)[i]);
+		}
+		Sorted.StableSort(FKeyframeTimeLess());
+		TArray<bool> Keep;
+		Keep.Init(Sorted.Num()<=2,Sorted.Num());
+		if(Sorted.Num()>2)
+		{
+			Keep[0]=Keep[Sorted.Num()-1]=true;
+			// Each span keeps its worst keyframe and is split there, until every keyframe left out is within tolerance.
+			TArray<FIntPoint> Spans;
+			Spans.Add(FIntPoint(0,Sorted.Num()-1));
+			while(Spans.Num())
+			{
+				FIntPoint Span=Spans.Pop();
+				TSharedPtr<FJsonObject> Before	=Sorted[Span.X]->AsObject();
+				TSharedPtr<FJsonObject> After	=Sorted[Span.Y]->AsObject();
+				double T0	=GetKeyframeTime(Sorted[Span.X]);
+				double T1	=GetKeyframeTime(Sorted[Span.Y]);
+				float WorstError=1.0f;
+				int32 Worst=INDEX_NONE;
+				for(int32 i=Span.X+1;i<Span.Y;i++)
+				{
+					double Alpha=T1>T0?(GetKeyframeTime(Sorted[i])-T0)/(T1-T0):0.0;
+					float Error=GetKeyframeError(It.Key(),Sorted[i]->AsObject(),Before,After,Alpha,DefaultTolerance,Tolerances);
+					if(Error>WorstError)
+					{
+						WorstError	=Error;
+						Worst		=i;
+					}
+				}
+				if(Worst==INDEX_NONE)
+					continue;
+				Keep[Worst]=true;
+				if(Worst-Span.X>1)
+					Spans.Add(FIntPoint(Span.X,Worst));
+				if(Span.Y-Worst>1)
+					Spans.Add(FIntPoint(Worst,Span.Y));
+			}
+		}
+		for(int32 i=0;i<Sorted.Num();i++)
+		{
+			if(Keep[i])
+				Simplified.Add(Sorted[i]);
+		}
+		OutStats.KeyframesBefore	+=Keyframes->Num();
+		OutStats.KeyframesAfter		+=Simplified.Num();
+		It.Value()->AsObject()->SetArrayField(TEXT("keyframes"),Simplified);
+	}
+	WriteJson(Sequence,OutText);
+	TSharedPtr<FJsonObject> Reparsed;
+	StartTime=FPlatformTime::Seconds();
+	ReadJson(OutText,Reparsed);
+	OutStats.ParseSecondsAfter=FPlatformTime::Seconds()-StartTime;
+	return true;
+}
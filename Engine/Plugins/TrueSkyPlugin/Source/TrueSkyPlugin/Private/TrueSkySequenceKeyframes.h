@@ -0,0 +1,43 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+/**
+ * Operations on a sequence's keyframes, for cooking and streaming. The sequence text is JSON; each
+ * member object with a "keyframes" array is a layer (sky, clouds, 2D clouds), whose keyframes are
+ * objects timed by "daytime", in days from the start of the sequence. Untimed keyframes are left alone.
+ */
+class FTrueSkySequenceKeyframes
+{
+public:
+	/** Most blocks Split makes; longer timelines need longer blocks. */
+	static const int32 MaxBlocks=4096;
+
+	struct FSimplifyStats
+	{
+		int32		KeyframesBefore;
+		int32		KeyframesAfter;
+		/** Time to parse the text before and after. */
+		double		ParseSecondsBefore;
+		double		ParseSecondsAfter;
+	};
+
+	/**
+	 * Removes the keyframes whose parameters all lie within tolerance of the line between the keyframes either side
+	 * that are kept (Douglas-Peucker). Tolerances maps "layer.parameter", "parameter" or "layer" to the error allowed,
+	 * the first found applying; DefaultTolerance applies to the rest. Keyframes whose other values differ are kept.
+	 */
+	static bool		Simplify(const TArray<uint8> &Text,float DefaultTolerance,const TMap<FString,float> &Tolerances,TArray<uint8> &OutText,FSimplifyStats &OutStats);
+
+	/**
+	 * Splits Text's keyframes into blocks of BlockDays by time. OutCoarse keeps the rest of the sequence and the
+	 * first and last keyframes of each block, to fall back on where the block isn't loaded. Each block holds its
+	 * layers' keyframes as {"layer":[...]}. False if there would be fewer than two blocks, or too many.
+	 */
+	static bool		Split(const TArray<uint8> &Text,float BlockDays,TArray<uint8> &OutCoarse,TArray< TArray<uint8> > &OutBlocks);
+
+	/**
+	 * Replaces Coarse's keyframes from StartDay up to EndDay with those of Blocks, the blocks covering that time.
+	 * Any thread.
+	 */
+	static bool		Merge(const TArray<uint8> &Coarse,const TArray< TArray<uint8> > &Blocks,float StartDay,float EndDay,TArray<uint8> &OutText);
+};
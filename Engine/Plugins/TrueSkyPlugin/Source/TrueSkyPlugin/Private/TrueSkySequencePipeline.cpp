@@ -0,0 +1,186 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkySequencePipeline.h"
+
+FTrueSkySequencePipeline::FTrueSkySequencePipeline()
+	:NextSerial(0)
+	,WorkEvent(NULL)
+	,Thread(NULL)
+	,PrepareSequence(NULL)
+	,ReleasePreparedSequence(NULL)
+{
+}
+
+FTrueSkySequencePipeline::~FTrueSkySequencePipeline()
+{
+	Shutdown();
+}
+
+void FTrueSkySequencePipeline::Startup()
+{
+	if(Thread)
+		return;
+	StopRequested.Reset();
+	WorkEvent	=FPlatformProcess::CreateSynchEvent();
+	Thread		=FRunnableThread::Create(this,TEXT("TrueSkySequencePipeline"),0,TPri_BelowNormal);
+}
+
+void FTrueSkySequencePipeline::Shutdown()
+{
+	if(Thread)
+	{
+		Thread->Kill(true);
+		delete Thread;
+		Thread=NULL;
+	}
+	delete WorkEvent;
+	WorkEvent=NULL;
+	FScopeLock Lock(&CriticalSection);
+	for(int32 i=0;i<Entries.Num();i++)
+		ReleaseEntry(Entries[i]);
+	Entries.Empty();
+}
+
+void FTrueSkySequencePipeline::SetPrepareFunctions(FPrepareSequence Prepare,FReleasePreparedSequence Release)
+{
+	FScopeLock Lock(&CriticalSection);
+	PrepareSequence			=Prepare;
+	ReleasePreparedSequence	=Release;
+}
+
+int32 FTrueSkySequencePipeline::FindEntry(const void *Key) const
+{
+	for(int32 i=0;i<Entries.Num();i++)
+	{
+		if(Entries[i]->Key==Key)
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+int32 FTrueSkySequencePipeline::FindEntryBySerial(uint32 Serial) const
+{
+	for(int32 i=0;i<Entries.Num();i++)
+	{
+		if(Entries[i]->Serial==Serial)
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+void FTrueSkySequencePipeline::ReleaseEntry(FEntry *Entry)
+{
+	if(Entry->Prepared&&ReleasePreparedSequence)
+		ReleasePreparedSequence(Entry->Prepared);
+	delete Entry;
+}
+
+void FTrueSkySequencePipeline::Prefetch(const void *Key,const TArray<uint8> &SequenceText)
+{
+	if(!Key||SequenceText.Num()==0)
+		return;
+	FEntry *Entry	=new FEntry;
+	Entry->Key		=Key;
+	Entry->Text		=std::string((const char*)SequenceText.GetData(),strnlen((const char*)SequenceText.GetData(),SequenceText.Num()));
+	Entry->Prepared	=NULL;
+	Entry->Ready	=false;
+	{
+		FScopeLock Lock(&CriticalSection);
+		int32 i=FindEntry(Key);
+		if(i!=INDEX_NONE)
+		{
+			ReleaseEntry(Entries[i]);
+			Entries.RemoveAt(i);
+		}
+		Entry->Serial=NextSerial++;
+		Entries.Add(Entry);
+	}
+	if(WorkEvent)
+		WorkEvent->Trigger();
+}
+
+bool FTrueSkySequencePipeline::IsPrefetched(const void *Key) const
+{
+	FScopeLock Lock(&CriticalSection);
+	return FindEntry(Key)!=INDEX_NONE;
+}
+
+bool FTrueSkySequencePipeline::TakePrepared(const void *Key,void *&OutPrepared,std::string &OutText)
+{
+	FScopeLock Lock(&CriticalSection);
+	int32 i=FindEntry(Key);
+	if(i==INDEX_NONE||!Entries[i]->Ready)
+		return false;
+	FEntry *Entry	=Entries[i];
+	OutPrepared		=Entry->Prepared;
+	OutText.swap(Entry->Text);
+	Entries.RemoveAt(i);
+	delete Entry;
+	return true;
+}
+
+void FTrueSkySequencePipeline::Forget(const void *Key)
+{
+	FScopeLock Lock(&CriticalSection);
+	int32 i=FindEntry(Key);
+	if(i!=INDEX_NONE)
+	{
+		ReleaseEntry(Entries[i]);
+		Entries.RemoveAt(i);
+	}
+}
+
+uint32 FTrueSkySequencePipeline::Run()
+{
+	while(StopRequested.GetValue()==0)
+	{
+		// Find one unprepared entry; prepare it outside the lock so the other threads aren't held up by the parse.
+		FEntry *Work=NULL;
+		uint32 WorkSerial=0;
+		FPrepareSequence Prepare=NULL;
+		std::string Text;
+		{
+			FScopeLock Lock(&CriticalSection);
+			for(int32 i=0;i<Entries.Num()&&!Work;i++)
+			{
+				if(!Entries[i]->Ready)
+					Work=Entries[i];
+			}
+			if(Work)
+			{
+				WorkSerial	=Work->Serial;
+				Text		=Work->Text;
+				Prepare		=PrepareSequence;
+			}
+		}
+		if(!Work)
+		{
+			WorkEvent->Wait(100);
+			continue;
+		}
+		void *Prepared=Prepare?Prepare(Text.c_str()):NULL;
+		{
+			FScopeLock Lock(&CriticalSection);
+			// It may have been replaced or forgotten meanwhile, and a new entry allocated at the same address.
+			int32 i=FindEntryBySerial(WorkSerial);
+			if(i!=INDEX_NONE&&!Entries[i]->Ready)
+			{
+				Entries[i]->Prepared	=Prepared;
+				Entries[i]->Ready		=true;
+			}
+			else if(Prepared&&ReleasePreparedSequence)
+			{
+				ReleasePreparedSequence(Prepared);
+			}
+		}
+	}
+	return 0;
+}
+
+void FTrueSkySequencePipeline::Stop()
+{
+	StopRequested.Increment();
+	if(WorkEvent)
+		WorkEvent->Trigger();
+}
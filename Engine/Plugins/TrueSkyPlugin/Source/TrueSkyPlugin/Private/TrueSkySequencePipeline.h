@@ -0,0 +1,61 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+#include <string>
+
+/**
+ * Prepares sequences on a worker thread ahead of their use, so that switching sequence doesn't
+ * convert or parse on the render thread. If the render dll exports StaticPrepareSequence, the
+ * parse happens here too; otherwise only the text is made ready.
+ */
+class FTrueSkySequencePipeline : public FRunnable
+{
+public:
+	typedef void* (*FPrepareSequence)( const char *sequenceInputText );
+	typedef void (*FReleasePreparedSequence)( void *prepared );
+
+	FTrueSkySequencePipeline();
+	virtual ~FTrueSkySequencePipeline();
+
+	void				Startup();
+	void				Shutdown();
+	/** The dll's prepare/release exports, once it's loaded. Either may be NULL. */
+	void				SetPrepareFunctions(FPrepareSequence Prepare,FReleasePreparedSequence Release);
+
+	/** Queues a sequence for preparation. The text is copied, so the caller can let go of it. Any thread. */
+	void				Prefetch(const void *Key,const TArray<uint8> &SequenceText);
+	/** True if Key is queued or prepared. */
+	bool				IsPrefetched(const void *Key) const;
+	/** Takes Key's prepared sequence, if it's ready. OutPrepared is NULL when the dll can't prepare. */
+	bool				TakePrepared(const void *Key,void *&OutPrepared,std::string &OutText);
+	/** Drops Key, e.g. when its asset is destroyed. */
+	void				Forget(const void *Key);
+
+	// Begin FRunnable interface.
+	virtual uint32		Run() override;
+	virtual void		Stop() override;
+	// End FRunnable interface.
+
+protected:
+	struct FEntry
+	{
+		const void		*Key;
+		/** Unique per entry, so the worker can tell its entry from a later one at the same address. */
+		uint32			Serial;
+		std::string		Text;
+		void			*Prepared;
+		bool			Ready;
+	};
+	int32				FindEntry(const void *Key) const;
+	int32				FindEntryBySerial(uint32 Serial) const;
+	void				ReleaseEntry(FEntry *Entry);
+
+	mutable FCriticalSection	CriticalSection;
+	TArray<FEntry*>		Entries;
+	uint32				NextSerial;
+	FEvent				*WorkEvent;
+	FRunnableThread		*Thread;
+	FThreadSafeCounter	StopRequested;
+	FPrepareSequence	PrepareSequence;
+	FReleasePreparedSequence ReleasePreparedSequence;
+};
@@ -0,0 +1,181 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyWeatherGrid.h"
+#if PLATFORM_WINDOWS
+#include "AllowWindowsPlatformTypes.h"
+#endif
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyWeatherGrid, Log, All);
+
+static const double EarthRadiusMetres=6371000.0;
+
+FTrueSkyWeatherGrid::FTrueSkyWeatherGrid()
+	:Header(NULL)
+	,StepHours(NULL)
+	,Data(NULL)
+	,FileHandle(NULL)
+	,MappingHandle(NULL)
+	,View(NULL)
+{
+}
+
+FTrueSkyWeatherGrid::~FTrueSkyWeatherGrid()
+{
+	Close();
+}
+
+bool FTrueSkyWeatherGrid::Open(const FString &Filename)
+{
+	Close();
+#if PLATFORM_WINDOWS
+	HANDLE File=CreateFileW(*Filename,GENERIC_READ,FILE_SHARE_READ,NULL,OPEN_EXISTING,FILE_FLAG_RANDOM_ACCESS,NULL);
+	if(File==INVALID_HANDLE_VALUE)
+	{
+		UE_LOG(TrueSkyWeatherGrid,Warning,TEXT("Can't open %s"),*Filename);
+		return false;
+	}
+	FileHandle=File;
+	LARGE_INTEGER FileSize;
+	GetFileSizeEx(File,&FileSize);
+	MappingHandle=CreateFileMappingW(File,NULL,PAGE_READONLY,0,0,NULL);
+	View=MappingHandle?MapViewOfFile((HANDLE)MappingHandle,FILE_MAP_READ,0,0,0):NULL;
+	if(!View)
+	{
+		UE_LOG(TrueSkyWeatherGrid,Warning,TEXT("Can't map %s"),*Filename);
+		Close();
+		return false;
+	}
+	const FTrueSkyWeatherGridHeader *H=(const FTrueSkyWeatherGridHeader*)View;
+	uint64 Expected=sizeof(FTrueSkyWeatherGridHeader);
+	if((uint64)FileSize.QuadPart>=Expected)
+		Expected+=sizeof(float)*((uint64)H->Steps+(uint64)H->Steps*H->Layers*H->Width*H->Height);
+	if(H->Magic!=FTrueSkyWeatherGridHeader::MAGIC||H->Version!=1||H->Layers<WEATHER_LAYER_COUNT
+		||H->Width<2||H->Height<2||H->Steps==0||(uint64)FileSize.QuadPart<Expected)
+	{
+		UE_LOG(TrueSkyWeatherGrid,Warning,TEXT("%s is not a valid weather grid"),*Filename);
+		Close();
+		return false;
+	}
+	Header		=H;
+	StepHours	=(const float*)(H+1);
+	Data		=StepHours+H->Steps;
+	UE_LOG(TrueSkyWeatherGrid,Log,TEXT("Mapped %s: %ux%u, %u steps"),*Filename,H->Width,H->Height,H->Steps);
+	return true;
+#else
+	UE_LOG(TrueSkyWeatherGrid,Warning,TEXT("Weather grids are only supported on Windows"));
+	return false;
+#endif
+}
+
+void FTrueSkyWeatherGrid::Close()
+{
+#if PLATFORM_WINDOWS
+	if(View)
+		UnmapViewOfFile(View);
+	if(MappingHandle)
+		CloseHandle((HANDLE)MappingHandle);
+	if(FileHandle)
+		CloseHandle((HANDLE)FileHandle);
+#endif
+	MappingHandle	=NULL;
+	FileHandle		=NULL;
+	View		=NULL;
+	Header		=NULL;
+	StepHours	=NULL;
+	Data		=NULL;
+}
+
+bool FTrueSkyWeatherGrid::IsGlobal() const
+{
+	// Global grids usually stop a column short of 360 degrees, the last column's right neighbour being the first.
+	return Header->Width*FMath::Abs(Header->DeltaLongitude)>=360.0-0.5*FMath::Abs(Header->DeltaLongitude);
+}
+
+float FTrueSkyWeatherGrid::SampleLayer(int32 Step,int32 Layer,double X,double Y,bool Global) const
+{
+	int32 W=Header->Width,H=Header->Height;
+	Y=FMath::Clamp(Y,0.0,(double)(H-1));
+	int32 Y0=FMath::Min((int32)Y,H-2);
+	int32 X0,X1;
+	if(Global)
+	{
+		X0=FMath::Clamp((int32)X,0,W-1);
+		X1=(X0+1)%W;
+	}
+	else
+	{
+		X=FMath::Clamp(X,0.0,(double)(W-1));
+		X0=FMath::Min((int32)X,W-2);
+		X1=X0+1;
+	}
+	float FX=(float)(X-X0),FY=(float)(Y-Y0);
+	const float *Plane=Data+((uint64)Step*Header->Layers+Layer)*(uint64)W*H;
+	const float *Row0=Plane+(uint64)Y0*W;
+	const float *Row1=Row0+W;
+	return FMath::Lerp(FMath::Lerp(Row0[X0],Row0[X1],FX),FMath::Lerp(Row1[X0],Row1[X1],FX),FY);
+}
+
+void FTrueSkyWeatherGrid::Sample(const FDateTime &Time,double WorldLatitude,double WorldLongitude,const FVector2D &Origin,float Size,int32 Resolution,TArray<FFloat16Color> &OutTexels) const
+{
+	OutTexels.SetNum(Resolution*Resolution);
+	if(!Header)
+		return;
+	// Bracketing steps and the blend between them.
+	double Hours=(Time-FDateTime::FromUnixTimestamp(Header->ReferenceTime)).GetTotalHours();
+	int32 Step0=0,Step1=0;
+	float StepAlpha=0.0f;
+	for(uint32 i=0;i<Header->Steps;i++)
+	{
+		if(StepHours[i]<=Hours)
+			Step0=Step1=i;
+	}
+	if(Step0+1<(int32)Header->Steps&&Hours>StepHours[Step0])
+	{
+		Step1=Step0+1;
+		StepAlpha=FMath::Clamp((float)((Hours-StepHours[Step0])/FMath::Max(0.001,(double)(StepHours[Step1]-StepHours[Step0]))),0.0f,1.0f);
+	}
+	// Local equirectangular projection about the world origin: X is north, Y east, in cm.
+	double DegreesPerCm	=FMath::RadiansToDegrees(1.0)/(EarthRadiusMetres*100.0);
+	double CosLatitude	=FMath::Max(0.01,FMath::Cos(FMath::DegreesToRadians(WorldLatitude)));
+	double Texel		=Size/(double)Resolution;
+	bool Global			=IsGlobal();
+	double Span			=(Header->Width-1)*Header->DeltaLongitude;
+	for(int32 j=0;j<Resolution;j++)
+	{
+		double WorldY	=Origin.Y+(j+0.5)*Texel;
+		double Longitude=WorldLongitude+WorldY*DegreesPerCm/CosLatitude;
+		// East of the grid's first column, in [0,360), so that longitudes either side of the antimeridian meet.
+		double East		=Longitude-Header->Longitude0;
+		East			-=360.0*floor(East/360.0);
+		// A regional grid: west of it is nearer its first column than its last.
+		if(!Global&&East>Span+0.5*(360.0-Span))
+			East-=360.0;
+		double GridX	=East/Header->DeltaLongitude;
+		if(Global)
+			GridX-=Header->Width*floor(GridX/Header->Width);
+		FFloat16Color *Row=OutTexels.GetData()+j*Resolution;
+		for(int32 i=0;i<Resolution;i++)
+		{
+			double WorldX	=Origin.X+(i+0.5)*Texel;
+			double Latitude	=WorldLatitude+WorldX*DegreesPerCm;
+			double GridY	=(Latitude-Header->Latitude0)/Header->DeltaLatitude;
+			float Values[WEATHER_LAYER_COUNT];
+			for(int32 l=0;l<WEATHER_LAYER_COUNT;l++)
+			{
+				float V=SampleLayer(Step0,l,GridX,GridY,Global);
+				if(Step1!=Step0)
+					V=FMath::Lerp(V,SampleLayer(Step1,l,GridX,GridY,Global),StepAlpha);
+				Values[l]=V;
+			}
+			Row[i]=FFloat16Color(FLinearColor(FMath::Clamp(Values[WEATHER_LAYER_COVERAGE],0.0f,1.0f)
+											,FMath::Clamp(Values[WEATHER_LAYER_HUMIDITY],0.0f,1.0f)
+											,Values[WEATHER_LAYER_WIND_NORTH]
+											,Values[WEATHER_LAYER_WIND_EAST]));
+		}
+	}
+}
+
+#if PLATFORM_WINDOWS
+#include "HideWindowsPlatformTypes.h"
+#endif
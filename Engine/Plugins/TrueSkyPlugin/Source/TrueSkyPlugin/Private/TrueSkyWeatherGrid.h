@@ -0,0 +1,71 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+#pragma once
+
+/**
+ * Header of a gridded forecast file (.tsgrid). GRIB and NetCDF forecasts are converted to this
+ * offline: a regular latitude/longitude grid, Steps forecast times, and for each step Layers
+ * float planes of Width x Height, row-major with latitude rows. It is memory-mapped, so only
+ * the pages around the camera are ever read, whatever the size of the grid.
+ */
+struct FTrueSkyWeatherGridHeader
+{
+	enum { MAGIC=0x44524754 };	// "TGRD"
+	uint32	Magic;
+	uint32	Version;
+	uint32	Width;
+	uint32	Height;
+	uint32	Steps;
+	uint32	Layers;
+	/** Latitude and longitude of the centre of texel (0,0), and the spacing, in degrees. */
+	double	Latitude0;
+	double	Longitude0;
+	double	DeltaLatitude;
+	double	DeltaLongitude;
+	/** Unix time of the forecast's reference time. Followed by Steps floats: the hours of each step after it. */
+	int64	ReferenceTime;
+};
+
+/** The layers of a .tsgrid file, in order. */
+enum ETrueSkyWeatherLayer
+{
+	WEATHER_LAYER_COVERAGE=0,	// 0-1
+	WEATHER_LAYER_HUMIDITY,		// 0-1
+	WEATHER_LAYER_WIND_EAST,	// m/s
+	WEATHER_LAYER_WIND_NORTH,	// m/s
+	WEATHER_LAYER_COUNT
+};
+
+class FTrueSkyWeatherGrid
+{
+public:
+	FTrueSkyWeatherGrid();
+	~FTrueSkyWeatherGrid();
+
+	bool			Open(const FString &Filename);
+	void			Close();
+	bool			IsOpen() const
+	{
+		return Header!=NULL;
+	}
+
+	/**
+	 * Fills a Resolution x Resolution window of the world, Size cm across with its minimum corner at Origin,
+	 * with coverage, humidity and the wind in world axes (X north, Y east), interpolated to Time.
+	 * WorldLatitude and WorldLongitude give the location of the world origin. Safe to call from any thread.
+	 */
+	void			Sample(const FDateTime &Time,double WorldLatitude,double WorldLongitude,const FVector2D &Origin,float Size,int32 Resolution,TArray<FFloat16Color> &OutTexels) const;
+
+protected:
+	/** True if the grid's columns go all the way round, so that X wraps rather than clamps. */
+	bool			IsGlobal() const;
+	/** Bilinear sample of a layer at fractional grid coordinates; X in [0,Width) if the grid is global. */
+	float			SampleLayer(int32 Step,int32 Layer,double X,double Y,bool Global) const;
+
+	const FTrueSkyWeatherGridHeader *Header;
+	const float		*StepHours;
+	const float		*Data;
+	/** Win32 file and mapping handles. */
+	void			*FileHandle;
+	void			*MappingHandle;
+	const void		*View;
+};
@@ -0,0 +1,138 @@
+#include "TrueSkyPluginPrivatePCH.h"
+#include "TrueSkyWeatherScheduler.h"
+#include "TrueSkySequenceAsset.h"
+
+DEFINE_LOG_CATEGORY_STATIC(TrueSkyWeather, Log, All);
+
+UTrueSkyWeatherScheduler::UTrueSkyWeatherScheduler(const class FPostConstructInitializeProperties& PCIP)
+	:Super(PCIP)
+	,Enabled(false)
+	,RandomSeed(0)
+	,Started(false)
+	,CurrentState(INDEX_NONE)
+	,NextState(INDEX_NONE)
+	,StateTime(0.0f)
+	,StateDuration(0.0f)
+{
+}
+
+FName UTrueSkyWeatherScheduler::GetCurrentState() const
+{
+	return States.IsValidIndex(CurrentState)?States[CurrentState].Name:NAME_None;
+}
+
+FName UTrueSkyWeatherScheduler::GetNextState() const
+{
+	return States.IsValidIndex(NextState)?States[NextState].Name:NAME_None;
+}
+
+void UTrueSkyWeatherScheduler::ForceState(FName Name)
+{
+	int32 Index=FindState(Name);
+	if(Index==INDEX_NONE)
+	{
+		UE_LOG(TrueSkyWeather, Warning, TEXT("TrueSky weather: no state called %s"),*Name.ToString());
+		return;
+	}
+	EnterState(Index);
+}
+
+int32 UTrueSkyWeatherScheduler::FindState(FName Name) const
+{
+	for(int32 i=0;i<States.Num();i++)
+	{
+		if(States[i].Name==Name)
+			return i;
+	}
+	return INDEX_NONE;
+}
+
+int32 UTrueSkyWeatherScheduler::ChooseNextState(int32 From)
+{
+	if(States.Num()<2)
+		return From;
+	FName FromName=States[From].Name;
+	float Total=0.0f;
+	for(int32 i=0;i<Transitions.Num();i++)
+	{
+		if(Transitions[i].From==FromName&&FindState(Transitions[i].To)!=INDEX_NONE)
+			Total+=Transitions[i].Weight;
+	}
+	if(Total<=0.0f)
+	{
+		int32 Index=RandomStream.RandRange(0,States.Num()-2);
+		return Index>=From?Index+1:Index;
+	}
+	float Pick=RandomStream.FRand()*Total;
+	int32 Last=From;
+	for(int32 i=0;i<Transitions.Num();i++)
+	{
+		const FTrueSkyWeatherTransition &T=Transitions[i];
+		int32 To=T.From==FromName?FindState(T.To):INDEX_NONE;
+		if(To==INDEX_NONE||T.Weight<=0.0f)
+			continue;
+		Last=To;
+		Pick-=T.Weight;
+		if(Pick<0.0f)
+			return To;
+	}
+	return Last;
+}
+
+void UTrueSkyWeatherScheduler::EnterState(int32 Index)
+{
+	ITrueSkyPlugin &TrueSkyPlugin=ITrueSkyPlugin::Get();
+	FStringAssetReference LeavingSequence	=States.IsValidIndex(CurrentState)?States[CurrentState].Sequence.ToStringReference():FStringAssetReference();
+	FStringAssetReference SkippedSequence	=States.IsValidIndex(NextState)?States[NextState].Sequence.ToStringReference():FStringAssetReference();
+	CurrentState	=Index;
+	StateTime		=0.0f;
+	const FTrueSkyWeatherState &State=States[Index];
+	StateDuration	=RandomStream.FRandRange(State.MinDuration,FMath::Max(State.MinDuration,State.MaxDuration));
+	BlendFrom.SetNum(State.Parameters.Num());
+	for(int32 i=0;i<State.Parameters.Num();i++)
+		BlendFrom[i]=TrueSkyPlugin.GetRenderFloat(State.Parameters[i].Name);
+	// Decide what follows now, so its sequence is ready long before the switch.
+	NextState=ChooseNextState(Index);
+	if(!State.Sequence.IsNull())
+		TrueSkyPlugin.StreamSequence(State.Sequence.ToStringReference());
+	if(States.IsValidIndex(NextState)&&!States[NextState].Sequence.IsNull())
+		TrueSkyPlugin.StreamSequence(States[NextState].Sequence.ToStringReference());
+	// The actor holds the sequence it's using; the one it's leaving, and a skipped next state's, needn't stay loaded -
+	// unless the new state or the one after it uses the same sequence, whose prefetched copy would be forgotten with it.
+	FStringAssetReference KeptSequence	=State.Sequence.ToStringReference();
+	FStringAssetReference NextSequence	=States.IsValidIndex(NextState)?States[NextState].Sequence.ToStringReference():FStringAssetReference();
+	if(LeavingSequence!=KeptSequence&&LeavingSequence!=NextSequence)
+		TrueSkyPlugin.ReleaseSequence(LeavingSequence);
+	if(SkippedSequence!=LeavingSequence&&SkippedSequence!=KeptSequence&&SkippedSequence!=NextSequence)
+		TrueSkyPlugin.ReleaseSequence(SkippedSequence);
+}
+
+UTrueSkySequenceAsset* UTrueSkyWeatherScheduler::Update(float DeltaTime)
+{
+	if(!Enabled||States.Num()==0||!ITrueSkyPlugin::IsAvailable())
+		return NULL;
+	if(!Started)
+	{
+		Started=true;
+		RandomStream.Initialize(RandomSeed?RandomSeed:FMath::Rand());
+		int32 Initial=FindState(InitialState);
+		EnterState(Initial!=INDEX_NONE?Initial:0);
+		// No blend into the first state.
+		StateTime=States[CurrentState].BlendTime;
+	}
+	if(!States.IsValidIndex(CurrentState))
+		return NULL;
+	StateTime+=DeltaTime;
+	if(StateTime>=StateDuration&&States.IsValidIndex(NextState))
+		EnterState(NextState);
+	const FTrueSkyWeatherState &State=States[CurrentState];
+	ITrueSkyPlugin &TrueSkyPlugin=ITrueSkyPlugin::Get();
+	float Alpha=State.BlendTime>0.0f?FMath::Clamp(StateTime/State.BlendTime,0.0f,1.0f):1.0f;
+	// Past the blend the values are left to the sequence and anything else that sets them, so only write while blending and once at the end.
+	if(StateTime-DeltaTime<=State.BlendTime)
+	{
+		for(int32 i=0;i<State.Parameters.Num();i++)
+			TrueSkyPlugin.SetRenderFloat(State.Parameters[i].Name,FMath::Lerp(BlendFrom[i],State.Parameters[i].Value,Alpha));
+	}
+	return State.Sequence.Get();
+}
@@ -4,6 +4,7 @@
 
 #include "ModuleManager.h"
 
+struct FStringAssetReference;
 
 /**
  * The public interface to this module.  In most cases, this interface is only public to sibling modules 
@@ -53,6 +54,23 @@ public:
 	virtual void	SetRenderingEnabled(bool) = 0;
 	
 	virtual class	UTrueSkySequenceAsset* GetActiveSequence()=0;
+	/** Loads a sequence for evaluation only, without enabling rendering - e.g. for baking on machines with no GPU. */
+	virtual bool	SetSequenceForEvaluation(class UTrueSkySequenceAsset* Sequence)=0;
+	/** Starts preparing a sequence on a worker thread, so that switching to it later doesn't hitch. */
+	virtual void	PrefetchSequence(class UTrueSkySequenceAsset* Sequence)=0;
+	/** Loads a sequence asynchronously, keeping it loaded until ReleaseSequence, and prefetches it once it's in. */
+	virtual void	StreamSequence(const FStringAssetReference &Sequence)=0;
+	/** Lets a sequence from StreamSequence unload, once nothing else references it. */
+	virtual void	ReleaseSequence(const FStringAssetReference &Sequence)=0;
+	/** Drops anything prefetched for a sequence, e.g. when it's destroyed, so its address can't be mistaken for another's. */
+	virtual void	ForgetSequence(class UTrueSkySequenceAsset* Sequence)=0;
+	/**
+	 * Replaces Region of the cloud coverage input (coverage, humidity, and wind north and east added to the
+	 * sequence's), which trueSKY samples in place of its global coverage. The input is Width x Height texels
+	 * covering Size cm of the world from Origin, repeating if Wrap is set. Texels holds Region's texels, or is
+	 * NULL to only move the input, and is deleted once uploaded. A Width of zero removes the input. Game thread.
+	 */
+	virtual void	UpdateCloudCoverageInput(int32 Width,int32 Height,const FVector2D &Origin,float Size,bool Wrap,const FIntRect &Region,TArray<FFloat16Color> *Texels)=0;
 	virtual void*	GetRenderEnvironment()=0;
 	virtual void	OnToggleRendering() = 0;
 };
@@ -0,0 +1,43 @@
+// Copyright 2013-2014 Simul Software Ltd. All Rights Reserved.
+
+#pragma once
+
+/** Sun and moon position for one place and time. Angles in degrees; azimuth clockwise from north. */
+struct FTrueSkyEphemerisResult
+{
+	float SunAzimuth;
+	float SunElevation;
+	float MoonAzimuth;
+	float MoonElevation;
+	/** Illuminated fraction of the moon disk, 0 (new) to 1 (full). */
+	float MoonIllumination;
+	/** Lunar phase, 0 (new) through 0.5 (full) to 1. */
+	float MoonPhase;
+};
+
+/**
+ * Low-precision solar and lunar ephemeris (Astronomical Almanac approximations: about 0.01 degrees
+ * for the sun over 1950-2050; the moon, with its six largest longitude terms and topocentric
+ * parallax, to about 0.3 degrees). No rendering dependencies, so it runs on dedicated servers too.
+ */
+class TRUESKYPLUGIN_API FTrueSkyEphemeris
+{
+public:
+	/** Latitude and longitude in degrees (north and east positive), time in UTC. */
+	static FTrueSkyEphemerisResult Compute(double Latitude,double Longitude,const FDateTime &UTCTime);
+
+	/**
+	 * Batch form over Count timestamps (Julian dates, UTC). Outputs are arrays of Count, any of which may be NULL.
+	 * Structure-of-arrays, for filling time-of-day curves in one call.
+	 */
+	static void Compute(int32 Count,const double *JulianDates,double Latitude,double Longitude
+		,float *OutSunAzimuth,float *OutSunElevation
+		,float *OutMoonAzimuth,float *OutMoonElevation
+		,float *OutMoonIllumination,float *OutMoonPhase);
+
+	/** Julian date of a UTC time, with the fraction of the day; FDateTime::GetJulianDay() drops it. */
+	static double GetJulianDate(const FDateTime &UTCTime)
+	{
+		return 1721425.5+(double)UTCTime.GetTicks()/ETimespan::TicksPerDay;
+	}
+};
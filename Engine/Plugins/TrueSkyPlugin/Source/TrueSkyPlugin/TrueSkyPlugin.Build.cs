@@ -65,6 +65,7 @@ namespace UnrealBuildTool.Rules
                     "D3D11RHI",
 					"Slate",
 					"SlateCore",
+					"Json",
                     "Renderer"
 					// ... add private dependencies that you statically link with here ...
 				}
@@ -39,6 +39,12 @@ static FAutoConsoleVariableRef CVarEarlyZPassMovable(
 	ECVF_RenderThreadSafe | ECVF_ReadOnly
 	);
 
+static TAutoConsoleVariable<int32> CVarSkyLPVCloudModulation(
+	TEXT("r.SkyLPVCloudModulation"),
+	1,
+	TEXT("Whether the flux light propagation volumes take from the sun is scaled by its transmittance through the sky extension's clouds."),
+	ECVF_RenderThreadSafe);
+
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 static TAutoConsoleVariable<int32> CVarTestUIBlur(
 	TEXT("UI.TestUIBlur"),
@@ -934,7 +940,12 @@ void FDeferredShadingSceneRenderer::Render(FRHICommandListImmediate& RHICmdList)
 
 	if( Views.Num() > 0 )
 	{
-		GetRendererModule().RenderPostOpaqueExtensions(Views[0]);
+		// Every view: stereo rendering has one per eye, each with its own fovea.
+		for(int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+		{
+			SCOPED_CONDITIONAL_DRAW_EVENTF(EventView, Views.Num() > 1, DEC_SCENE_ITEMS, TEXT("View%d"), ViewIndex);
+			GetRendererModule().RenderPostOpaqueExtensions(Views[ViewIndex]);
+		}
 	}
 	if (ViewFamily.EngineShowFlags.LightShafts)
 	{
@@ -1304,6 +1315,12 @@ void FDeferredShadingSceneRenderer::ClearLPVs(FRHICommandListImmediate& RHICmdLi
 			{
 				SCOPED_DRAW_EVENT(ClearLPVs, DEC_SCENE_ITEMS);
 				SCOPE_CYCLE_COUNTER(STAT_UpdateLPVs);
+				// The reflective shadow maps see the sun as if there were no clouds, so scale what the volume takes from them
+				// by the sun's transmittance. Propagation is linear, so this is the same as scaling the flux as it is injected.
+				if (CVarSkyLPVCloudModulation.GetValueOnRenderThread() != 0)
+				{
+					View.FinalPostProcessSettings.LPVIntensity *= GSkyRenderState.SunVisibility;
+				}
 				LightPropagationVolume->InitSettings(RHICmdList, Views[ViewIndex]);
 				LightPropagationVolume->Clear(RHICmdList);
 			}
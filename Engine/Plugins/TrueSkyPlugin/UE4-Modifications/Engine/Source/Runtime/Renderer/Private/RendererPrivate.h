@@ -16,6 +16,9 @@
 
 DECLARE_LOG_CATEGORY_EXTERN(LogRenderer, Log, All);
 
+/** Sky values from the sky extension, for the view uniform buffers. Render thread only. */
+extern FSkyRenderState GSkyRenderState;
+
 /** The renderer module implementation. */
 class FRendererModule : public IRendererModule
 {
@@ -62,10 +65,19 @@ public:
 
 	virtual void RegisterPostOpaqueRenderDelegate( const FPostOpaqueRenderDelegate& PostOpaqueRenderDelegate ) override;
 	virtual void RenderPostOpaqueExtensions( const FSceneView& View ) override;
+	virtual FRHITexture2D* GetPostOpaqueCloudDepthTexture( const FSceneView& View ) const override;
+	virtual void SetSkyRenderState( const FSkyRenderState& SkyRenderState ) override;
 
 private:
 	TSet<FSceneInterface*> AllocatedScenes;
 	FPostOpaqueRenderDelegate PostOpaqueRenderDelegate;
+	/** Each view's cloud depth, so that stereo eyes don't share one. Keyed by view state, or by view if it has none. */
+	struct FPostOpaqueCloudDepth
+	{
+		FTexture2DRHIRef Texture;
+		uint32 Frame;
+	};
+	TMap<const void*, FPostOpaqueCloudDepth> PostOpaqueCloudDepthTextures;
 };
 
 #endif
@@ -62,6 +62,67 @@ static TAutoConsoleVariable<int32> CVarMaxShadowCascades(
 	ECVF_Scalability | ECVF_RenderThreadSafe
 	);
 
+static TAutoConsoleVariable<int32> CVarPostOpaqueFoveation(
+	TEXT("r.PostOpaqueFoveation"),
+	1,
+	TEXT("Foveated rendering of post-opaque extensions (e.g. sky and clouds).\n")
+	TEXT(" 0: off\n")
+	TEXT(" 1: stereo views only (default)\n")
+	TEXT(" 2: all views"),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarPostOpaqueFoveaLensOffset(
+	TEXT("r.PostOpaqueFoveaLensOffset"),
+	0.05f,
+	TEXT("Horizontal offset of the lens centre from the middle of each eye's viewport, in viewport UV, towards the nose."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarPostOpaqueFoveaInnerRadius(
+	TEXT("r.PostOpaqueFoveaInnerRadius"),
+	0.25f,
+	TEXT("Radius around the fovea, in viewport UV, rendered at full quality."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarPostOpaqueFoveaOuterRadius(
+	TEXT("r.PostOpaqueFoveaOuterRadius"),
+	0.7f,
+	TEXT("Radius around the fovea, in viewport UV, at which quality reaches r.PostOpaqueFoveaMinScale."),
+	ECVF_RenderThreadSafe);
+
+static TAutoConsoleVariable<float> CVarPostOpaqueFoveaMinScale(
+	TEXT("r.PostOpaqueFoveaMinScale"),
+	0.25f,
+	TEXT("Resolution and sample-count scale in the periphery of foveated views."),
+	ECVF_RenderThreadSafe);
+
+FSkyRenderState GSkyRenderState;
+
+static TAutoConsoleVariable<int32> CVarSkyVisibilityCulling(
+	TEXT("r.SkyVisibilityCulling"),
+	1,
+	TEXT("Whether views cull primitives beyond the sky extension's visibility distance, when it publishes one."),
+	ECVF_RenderThreadSafe);
+
+/** Pulls in the far side of each perspective view's frustum to the visibility distance through the fog and cloud.
+  * The extension publishes that distance while rendering, so this applies the previous frame's plane. */
+static void ApplySkyVisibilityCulling(TArray<FViewInfo>& Views)
+{
+	if (CVarSkyVisibilityCulling.GetValueOnRenderThread() == 0 || GSkyRenderState.VisibilityDistance <= 0.0f)
+	{
+		return;
+	}
+	for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
+	{
+		FViewInfo& View = Views[ViewIndex];
+		if (View.IsPerspectiveProjection())
+		{
+			const FVector ViewDirection = View.GetViewDirection();
+			View.ViewFrustum.Planes.Add(FPlane(View.ViewMatrices.ViewOrigin + ViewDirection * GSkyRenderState.VisibilityDistance, ViewDirection));
+			View.ViewFrustum.Init();
+		}
+	}
+}
+
 static TAutoConsoleVariable<float> CVarTessellationAdaptivePixelsPerTriangle(
 	TEXT("r.TessellationAdaptivePixelsPerTriangle"),
 	48.0f,
@@ -498,6 +559,19 @@ TUniformBufferRef<FViewUniformShaderParameters> FViewInfo::CreateUniformBuffer(
 		FeatureLevel == ERHIFeatureLevel::ES2 &&
 		GMaxRHIFeatureLevel > ERHIFeatureLevel::ES2) ? 1.0f : 0.0f;
 
+	// Sky state from the sky extension (e.g. trueSKY), so materials needn't go through parameter collections.
+	ViewUniformShaderParameters.SkySunDirection = GSkyRenderState.SunDirection;
+	ViewUniformShaderParameters.SkySunColor = GSkyRenderState.SunColor;
+	ViewUniformShaderParameters.SkyMoonDirection = GSkyRenderState.MoonDirection;
+	ViewUniformShaderParameters.SkyParameters = FVector4(GSkyRenderState.TimeOfDay, GSkyRenderState.CloudShadowTexture.IsValid() ? GSkyRenderState.CloudShadowStrength : 0.0f, GSkyRenderState.CloudShadowSharpness, 0.0f);
+	// Maps world XY to the cloud shadow texture's UV.
+	const float InvCloudShadowSize = GSkyRenderState.CloudShadowSize > 0.0f ? 1.0f / GSkyRenderState.CloudShadowSize : 0.0f;
+	ViewUniformShaderParameters.SkyCloudShadowTransform = FVector4(
+		-GSkyRenderState.CloudShadowOrigin.X * InvCloudShadowSize,
+		-GSkyRenderState.CloudShadowOrigin.Y * InvCloudShadowSize,
+		InvCloudShadowSize,
+		InvCloudShadowSize);
+
 	return TUniformBufferRef<FViewUniformShaderParameters>::CreateUniformBufferImmediate(ViewUniformShaderParameters, UniformBuffer_SingleFrame);
 }
 
@@ -944,6 +1018,8 @@ static void RenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList,
 		GRenderTargetPool.SetEventRecordingActive(true);
 	}
 
+	ApplySkyVisibilityCulling(SceneRenderer->Views);
+
     {
 		SCOPE_CYCLE_COUNTER(STAT_TotalSceneRenderingTime);
 
@@ -1036,6 +1112,12 @@ void FRendererModule::RegisterPostOpaqueRenderDelegate( const FPostOpaqueRenderD
 	this->PostOpaqueRenderDelegate = PostOpaqueRenderDelegate;
 }
 
+void FRendererModule::SetSkyRenderState( const FSkyRenderState& SkyRenderState )
+{
+	check(IsInRenderingThread());
+	GSkyRenderState = SkyRenderState;
+}
+
 void FRendererModule::RenderPostOpaqueExtensions( const FSceneView& View )
 {
 	check(IsInRenderingThread());
@@ -1048,12 +1130,61 @@ void FRendererModule::RenderPostOpaqueExtensions( const FSceneView& View )
 
 	RenderParameters.DepthTexture = GSceneRenderTargets.GetSceneDepthSurface()->GetTexture2D();
 	RenderParameters.SmallDepthTexture = GSceneRenderTargets.GetSmallDepthSurface()->GetTexture2D();
+	RenderParameters.CloudDepthTexture = NULL;
 	
 	RenderParameters.ViewportRect = View.ViewRect;
 	
 	RenderParameters.Uid=(void*)(&View);
 
+	// Static lens centre for now: the middle of the viewport, shifted towards the nose for each eye.
+	RenderParameters.FoveaCenter = FVector2D(0.5f, 0.5f);
+	RenderParameters.FoveaInnerRadius = 1.0f;
+	RenderParameters.FoveaOuterRadius = 0.0f;
+	RenderParameters.FoveaMinScale = 1.0f;
+	const int32 Foveation = CVarPostOpaqueFoveation.GetValueOnRenderThread();
+	const bool bStereo = View.StereoPass != eSSP_FULL;
+	if (Foveation == 2 || (Foveation == 1 && bStereo))
+	{
+		const float LensOffset = CVarPostOpaqueFoveaLensOffset.GetValueOnRenderThread();
+		if (View.StereoPass == eSSP_LEFT_EYE)
+		{
+			RenderParameters.FoveaCenter.X += LensOffset;
+		}
+		else if (View.StereoPass == eSSP_RIGHT_EYE)
+		{
+			RenderParameters.FoveaCenter.X -= LensOffset;
+		}
+		RenderParameters.FoveaInnerRadius = CVarPostOpaqueFoveaInnerRadius.GetValueOnRenderThread();
+		RenderParameters.FoveaOuterRadius = FMath::Max(RenderParameters.FoveaInnerRadius, CVarPostOpaqueFoveaOuterRadius.GetValueOnRenderThread());
+		RenderParameters.FoveaMinScale = FMath::Clamp(CVarPostOpaqueFoveaMinScale.GetValueOnRenderThread(), 0.0625f, 1.0f);
+	}
+
 	PostOpaqueRenderDelegate.ExecuteIfBound( RenderParameters );
+
+	const void* Key = View.State ? (const void*)View.State : (const void*)&View;
+	FPostOpaqueCloudDepth* CloudDepth = PostOpaqueCloudDepthTextures.Find(Key);
+	if (!CloudDepth)
+	{
+		// Forget views that have gone away.
+		for (TMap<const void*, FPostOpaqueCloudDepth>::TIterator It(PostOpaqueCloudDepthTextures); It; ++It)
+		{
+			if (GFrameNumberRenderThread - It.Value().Frame > 2)
+			{
+				It.RemoveCurrent();
+			}
+		}
+		CloudDepth = &PostOpaqueCloudDepthTextures.Add(Key);
+	}
+	CloudDepth->Texture = RenderParameters.CloudDepthTexture;
+	CloudDepth->Frame = GFrameNumberRenderThread;
+}
+
+FRHITexture2D* FRendererModule::GetPostOpaqueCloudDepthTexture( const FSceneView& View ) const
+{
+	check(IsInRenderingThread());
+	const void* Key = View.State ? (const void*)View.State : (const void*)&View;
+	const FPostOpaqueCloudDepth* CloudDepth = PostOpaqueCloudDepthTextures.Find(Key);
+	return CloudDepth ? CloudDepth->Texture.GetReference() : NULL;
 }
 
 void FRendererModule::DrawRectangle(
@@ -420,12 +420,46 @@ class FPostOpaqueRenderParameters
 		FMatrix ProjMatrix;
 		FRHITexture2D * DepthTexture;
 		FRHITexture2D * SmallDepthTexture;
+		FRHITexture2D * CloudDepthTexture; ///< Out: reduced-resolution depth of the extension's translucent media (e.g. clouds), or NULL.
+		FVector2D FoveaCenter; ///< Focus point of this view (eye) in viewport UV.
+		float FoveaInnerRadius; ///< Radius, in viewport UV, inside which full quality is required.
+		float FoveaOuterRadius; ///< Radius at which quality has fallen to FoveaMinScale. Zero when foveation is off.
+		float FoveaMinScale; ///< Resolution/sample-count scale at and beyond FoveaOuterRadius.
 		void *Uid; ///< A unique identifier for the view.
 };
 
 
 DECLARE_DELEGATE_OneParam(FPostOpaqueRenderDelegate, class FPostOpaqueRenderParameters& );
 
+/** Sky values published by a sky extension on the render thread, and copied into every view's uniform buffer. */
+struct FSkyRenderState
+{
+	FSkyRenderState()
+		: SunDirection(0.0f, 0.0f, 1.0f)
+		, SunColor(FLinearColor::White)
+		, MoonDirection(0.0f, 0.0f, -1.0f)
+		, TimeOfDay(0.5f)
+		, SunVisibility(1.0f)
+		, CloudShadowStrength(0.0f)
+		, CloudShadowSharpness(0.0f)
+		, CloudShadowOrigin(0.0f, 0.0f)
+		, CloudShadowSize(0.0f)
+		, VisibilityDistance(0.0f)
+	{
+	}
+	FVector SunDirection; ///< Unit vector towards the sun, world space.
+	FLinearColor SunColor; ///< Sun irradiance, after the atmosphere.
+	FVector MoonDirection; ///< Unit vector towards the moon, world space.
+	float TimeOfDay; ///< Fraction of the day, 0-1.
+	float SunVisibility; ///< Transmittance of the sun disk through the clouds, 0-1.
+	float CloudShadowStrength; ///< 0 for no cloud shadow, 1 for full.
+	float CloudShadowSharpness;
+	FTexture2DRHIRef CloudShadowTexture; ///< Cloud transmittance towards the sun, looking down. NULL for none.
+	FVector2D CloudShadowOrigin; ///< World XY of CloudShadowTexture's minimum corner.
+	float CloudShadowSize; ///< World width of CloudShadowTexture.
+	float VisibilityDistance; ///< Distance through the fog and cloud at the camera beyond which nothing can be seen. 0 for unlimited.
+};
+
 
 /**
  * The public interface of the renderer module.
@@ -523,6 +557,10 @@ public:
 
 	virtual void RegisterPostOpaqueRenderDelegate( const FPostOpaqueRenderDelegate& PostOpaqueRenderDelegate ) = 0;
 	virtual void RenderPostOpaqueExtensions( const FSceneView& View ) = 0;
+	/** Depth output of the view's last post-opaque extension render, for depth-based post processing. May be NULL. */
+	virtual FRHITexture2D* GetPostOpaqueCloudDepthTexture( const FSceneView& View ) const = 0;
+	/** Sets the sky values for views created from now on. Render thread. */
+	virtual void SetSkyRenderState( const FSkyRenderState& SkyRenderState ) = 0;
 };
 
 